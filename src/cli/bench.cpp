@@ -0,0 +1,6 @@
+#include "../commands/commands.hpp"
+
+int main(int argc, char **argv)
+{
+	return commands::bench(argc, argv);
+}
@@ -1,29 +1,53 @@
+#include "../commands/commands.hpp"
 #include <iostream>
+#include <map>
 #include <string>
-#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
 #include <boost/program_options.hpp>
 
 namespace po = boost::program_options;
 std::string project_name(PROJECT_NAME);
 
+const std::map<std::string, commands::Main> subcommands{
+	{"bench", commands::bench},
+	{"dump", commands::dump},
+	{"inspect", commands::inspect},
+	{"run", commands::run},
+	{"serve", commands::serve},
+	{"touch", commands::touch},
+	{"train", commands::train},
+};
+
 int main(int argc, char **argv)
 {
+	// subcommands are run in this process, with their own name as argv[0] and the rest of the arguments as they are
+	if (argc > 1 && argv[1][0] != '-')
+	{
+		const std::string subcommand = argv[1];
+		if (subcommands.contains(subcommand))
+		{
+			return subcommands.at(subcommand)(argc - 1, argv + 1);
+		}
+
+		// other subcommands are separate tempest-<name> binaries on the PATH
+		const std::string command = project_name + "-" + subcommand;
+		argv[1] = const_cast<char *>(command.c_str());
+		execvp(command.c_str(), argv + 1);
+		std::cerr << "Unknown subcommand " << subcommand << ": " << std::strerror(errno) << std::endl;
+		return 127;
+	}
+
 	// Command-line options
 	po::variables_map options;
 	po::options_description cli("Options");
 	cli.add_options()
 		("help,h", "Display help message")
 		("version,v", "Display version");
-	po::options_description positionals;
-	positionals.add_options()
-		("command", "Subcommand")
-		("arguments", po::value<std::vector<std::string>>(), "Arguments");
-	po::positional_options_description _positionals;
-	_positionals.add("command", 1);
-	_positionals.add("arguments", -1);
 	try
 	{
-		po::store(po::command_line_parser(argc, argv).options(po::options_description().add(cli).add(positionals)).positional(_positionals).allow_unregistered().run(), options);
+		po::store(po::command_line_parser(argc, argv).options(cli).run(), options);
 	}
 	catch( const std::exception &ex)
 	{
@@ -38,19 +62,12 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
-	if (options.count("help") || !options.count("command"))
+	std::cout << "Usage: " << project_name << " <subcommand> [options]\n"
+			  << "Subcommands:";
+	for (const auto &[name, subcommand] : subcommands)
 	{
-		std::cout << "Usage: " << project_name << " <subcommand> [options]\n" << cli << std::endl;
-		return 0;
+		std::cout << " " << name;
 	}
-
-	std::string subcommand = options.at("command").as<std::string>();
-	std::string command = project_name + "-" + subcommand;
-
-    for (int i = 2; i < argc; i++)
-    {
-        command += " " + std::string(argv[i]);
-    }
-
-	return system(command.c_str());
+	std::cout << "\n" << cli << std::endl;
+	return 0;
 }
@@ -0,0 +1,420 @@
+#include "commands.hpp"
+#include "../core/File.hpp"
+#include "../core/NeuralNetwork.hpp"
+#include "../core/Inspector.hpp"
+#include <boost/program_options.hpp>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace po = boost::program_options;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// average outputs per neuron of generated networks
+	constexpr size_t fanout = 4;
+	constexpr size_t numInputs = 16, numOutputs = 16;
+
+	// names of File::Encoding
+	constexpr std::array<const char *, 3> encodings = {"stream", "mapped", "compact"};
+
+	struct Result
+	{
+		std::string name;
+		size_t connections = 0;
+		size_t iterations = 0;
+		std::string unit;	   // what throughput counts
+		double throughput = 0; // units per second
+		// nanoseconds per iteration
+		double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+		long peakRss = 0; // KiB, of the whole process once the benchmark is done
+	};
+
+	struct Options
+	{
+		double time = 1;
+		size_t minIterations = 5;
+		size_t maxIterations = 100000;
+	};
+
+	long peak_rss()
+	{
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+
+	/*
+		Runs f until the time budget is spent and at least minIterations have run, timing each call.
+		setup runs before each call and is not timed. Each call processes items units, for the throughput.
+	*/
+	template <typename Setup, typename F>
+	Result measure(const Options &options, const std::string &name, size_t connections, double items, const std::string &unit, Setup &&setup, F &&f)
+	{
+		log_debug("Running ", name, " (", connections, " connections)...");
+		std::vector<double> latencies;
+		double total = 0;
+		while (latencies.size() < options.maxIterations && (latencies.size() < options.minIterations || total < options.time))
+		{
+			setup();
+			const Clock::time_point start = Clock::now();
+			f();
+			const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+			latencies.push_back(elapsed * 1e9);
+			total += elapsed;
+		}
+
+		Result result;
+		result.name = name;
+		result.connections = connections;
+		result.iterations = latencies.size();
+		result.unit = unit;
+		result.throughput = total > 0 ? items * latencies.size() / total : 0;
+
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](double p)
+		{
+			return latencies[static_cast<size_t>(p * (latencies.size() - 1) + 0.5)];
+		};
+		result.mean = total * 1e9 / latencies.size();
+		result.p50 = percentile(0.5);
+		result.p90 = percentile(0.9);
+		result.p99 = percentile(0.99);
+		result.max = latencies.back();
+		result.peakRss = peak_rss();
+		return result;
+	}
+
+	// A network with the given number of connections between random neurons, the same for a seed
+	NeuralNetwork generate(size_t connections, uint64_t seed)
+	{
+		Random::Scope scope(seed, connections);
+		Random &random = Random::local();
+
+		const size_t numNeurons = std::max<size_t>(connections / fanout, numInputs + numOutputs + 1);
+		NeuralNetwork network;
+		network.reserve(numNeurons);
+		std::vector<size_t> ids;
+		ids.reserve(numNeurons);
+		for (size_t i = 0; i < numNeurons; i++)
+		{
+			NeuronType type = i < numInputs ? NeuronType::INPUT : (i >= numNeurons - numOutputs ? NeuronType::OUTPUT : NeuronType::TRANSITIONAL);
+			ids.push_back(network.create(type).id());
+		}
+
+		// connections go from any neuron but outputs to any neuron but inputs
+		for (size_t c = 0; c < connections; c++)
+		{
+			Neuron &source = network.get(ids[random.below(numNeurons - numOutputs)]);
+			Neuron::ConnectionData connection;
+			connection.neuron = ids[numInputs + random.below(numNeurons - numInputs)];
+			connection.strength = random.uniform(0.5f, 1.5f);
+			connection.reliability = random.uniform(0.8f, 1.0f);
+			source.addConnection(connection);
+		}
+		return network;
+	}
+
+	std::string json(const Result &result)
+	{
+		std::ostringstream out;
+		out << std::setprecision(10)
+			<< "{\"name\": \"" << result.name << "\""
+			<< ", \"connections\": " << result.connections
+			<< ", \"iterations\": " << result.iterations
+			<< ", \"throughput\": " << result.throughput
+			<< ", \"unit\": \"" << result.unit << "\""
+			<< ", \"latency\": {\"mean\": " << result.mean << ", \"p50\": " << result.p50 << ", \"p90\": " << result.p90 << ", \"p99\": " << result.p99 << ", \"max\": " << result.max << "}"
+			<< ", \"peakRss\": " << result.peakRss << "}";
+		return out.str();
+	}
+
+	// The number after "key": in a line of the output, or -1
+	double json_number(const std::string &line, const std::string &key)
+	{
+		const size_t position = line.find("\"" + key + "\": ");
+		if (position == std::string::npos)
+		{
+			return -1;
+		}
+		return std::stod(line.substr(position + key.size() + 4));
+	}
+
+	std::string json_string(const std::string &line, const std::string &key)
+	{
+		const size_t position = line.find("\"" + key + "\": \"");
+		if (position == std::string::npos)
+		{
+			return "";
+		}
+		const size_t begin = position + key.size() + 5;
+		return line.substr(begin, line.find('"', begin) - begin);
+	}
+
+	/*
+		Compares results with a baseline written by an earlier run, by median latency.
+		Returns the number of benchmarks slower than the baseline by more than the threshold.
+	*/
+	size_t compare(const std::vector<Result> &results, const std::string &path, double threshold)
+	{
+		std::ifstream baseline(path);
+		if (!baseline.is_open())
+		{
+			throw std::runtime_error("Failed to open baseline: " + path);
+		}
+
+		std::map<std::pair<std::string, size_t>, double> medians;
+		std::string line;
+		while (std::getline(baseline, line))
+		{
+			const std::string name = json_string(line, "name");
+			if (!name.empty())
+			{
+				medians[{name, static_cast<size_t>(json_number(line, "connections"))}] = json_number(line, "p50");
+			}
+		}
+
+		size_t regressions = 0;
+		std::cerr << std::left << std::setw(16) << "benchmark" << std::right << std::setw(12) << "connections" << std::setw(14) << "baseline" << std::setw(14) << "current" << std::setw(10) << "change" << std::endl;
+		for (const Result &result : results)
+		{
+			auto it = medians.find({result.name, result.connections});
+			if (it == medians.end() || it->second <= 0)
+			{
+				continue;
+			}
+			const double change = result.p50 / it->second - 1;
+			const bool regressed = change > threshold;
+			regressions += regressed;
+			std::cerr << std::left << std::setw(16) << result.name << std::right << std::setw(12) << result.connections
+					  << std::setw(12) << std::fixed << std::setprecision(0) << it->second << "ns"
+					  << std::setw(12) << result.p50 << "ns"
+					  << std::setw(9) << std::setprecision(1) << std::showpos << change * 100 << "%" << std::noshowpos
+					  << (regressed ? "  REGRESSION" : (change < -threshold ? "  improved" : "")) << std::endl;
+			std::cerr.unsetf(std::ios::fixed);
+		}
+		return regressions;
+	}
+}
+
+int commands::bench(int argc, char **argv)
+{
+	po::variables_map options;
+	po::options_description cli("Options");
+	cli.add_options()
+		("help,h", "Display help message")
+		("debug", "Show verbose/debug messages")
+		("connections,n", po::value<std::vector<size_t>>()->multitoken()->default_value({1000, 10000, 100000, 1000000, 10000000}, "1000 ... 10000000")->value_name("num"), "Sizes of the generated networks")
+		("filter,f", po::value<std::string>()->default_value("")->value_name("text"), "Only run benchmarks with names containing the text")
+		("time,t", po::value<double>()->default_value(1)->value_name("seconds"), "Time to spend on each benchmark")
+		("min-iterations", po::value<size_t>()->default_value(5)->value_name("num"), "Least number of iterations of each benchmark")
+		("seed", po::value<uint64_t>()->default_value(1)->value_name("seed"), "Random seed of the generated networks and mutations")
+		("directory,d", po::value<std::string>()->default_value(std::filesystem::temp_directory_path().string())->value_name("path"), "Where to write temporary files")
+		("output,o", po::value<std::string>()->value_name("path"), "Write results to a file instead of stdout")
+		("compare,c", po::value<std::string>()->value_name("path"), "Compare results with a baseline from an earlier run")
+		("threshold", po::value<double>()->default_value(0.1)->value_name("fraction"), "Slowdown of the median latency counted as a regression");
+
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(cli).run(), options);
+	}
+	catch (const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	po::notify(options);
+
+	if (options.count("help"))
+	{
+		std::cout << "Usage: [options]" << std::endl
+				  << cli << std::endl;
+		return 0;
+	}
+
+	debug = options.count("debug");
+
+	Options timing;
+	timing.time = options.at("time").as<double>();
+	timing.minIterations = std::max<size_t>(options.at("min-iterations").as<size_t>(), 1);
+	const uint64_t seed = options.at("seed").as<uint64_t>();
+	const std::string filter = options.at("filter").as<std::string>();
+	const std::string path = (std::filesystem::path(options.at("directory").as<std::string>()) / ("tempest-bench-" + std::to_string(getpid()) + ".tpst")).string();
+
+	auto enabled = [&](const std::string &name)
+	{
+		return name.find(filter) != std::string::npos;
+	};
+
+	std::vector<Result> results;
+	try
+	{
+		for (size_t connections : options.at("connections").as<std::vector<size_t>>())
+		{
+			log_debug("Generating a network with ", connections, " connections...");
+			NeuralNetwork network = generate(connections, seed);
+			Random::seed(seed);
+			Random &random = Random::local();
+
+			if (enabled("run"))
+			{
+				network.compile().propagation = Propagation::FRONTIER;
+				const NeuralNetwork::Values inputs(numInputs, 1);
+				// runs store values into the network, so each starts from the same ones
+				auto reset = [&]
+				{
+					for (auto &[id, neuron] : network)
+					{
+						neuron.value = Neuron::defaultValue;
+					}
+				};
+				results.push_back(measure(timing, "run", connections, connections, "connections", reset, [&]
+										  { network.run(inputs, 16); }));
+				network.invalidate();
+			}
+
+			if (enabled("mutate"))
+			{
+				NeuralNetwork copy(network);
+				results.push_back(measure(timing, "mutate", connections, 1, "mutations", [] {}, [&]
+										  {
+					try
+					{
+						copy.mutate();
+					}
+					catch (const std::exception &)
+					{
+						// e.g. removing a connection that does not exist
+					} }));
+			}
+
+			if (enabled("connect"))
+			{
+				NeuralNetwork copy(network);
+				Neuron *source = nullptr, *target = nullptr;
+				auto pick = [&]
+				{
+					source = &copy.at_slot(random.below(copy.slots() - numOutputs));
+					target = &copy.at_slot(numInputs + random.below(copy.slots() - numInputs));
+				};
+
+				// each connection is removed before the next is made, and made before it is removed, so the network keeps its size
+				results.push_back(measure(timing, "connect", connections, 1, "connections", [&]
+										  {
+					if (source != nullptr)
+					{
+						source->unconnect(*target);
+					}
+					pick(); }, [&]
+										  { source->connect(*target); }));
+				source->unconnect(*target);
+
+				results.push_back(measure(timing, "unconnect", connections, 1, "connections", [&]
+										  {
+					pick();
+					source->connect(*target); }, [&]
+										  { source->unconnect(*target); }));
+			}
+
+			// version 1 is the last streamed one
+			for (File::Version version : {File::StreamVersion, File::MappedVersion, File::CompactVersion})
+			{
+				const std::string encoding = encodings[static_cast<size_t>(File::encoding(version))];
+
+				File file;
+				file.magic(File::Magic);
+				file.type(FileType::NETWORK);
+				file.version(version);
+				delete file.network;
+				file.network = &network;
+				if (enabled("write/" + encoding))
+				{
+					results.push_back(measure(timing, "write/" + encoding, connections, connections, "connections", [] {}, [&]
+											  { file.writePath(path); }));
+				}
+				else
+				{
+					file.writePath(path);
+				}
+
+				if (enabled("read/" + encoding))
+				{
+					results.push_back(measure(timing, "read/" + encoding, connections, connections, "connections", [] {}, [&]
+											  {
+						File input;
+						input.readPath(path);
+						delete input.network; }));
+				}
+			}
+
+			if (enabled("inspect"))
+			{
+				Inspector inspector;
+				inspector.path(path);
+				inspector.load();
+				std::string command;
+				auto pick = [&]
+				{
+					command = "info 0 " + std::to_string(network.at_slot(random.below(network.slots())).id());
+				};
+				results.push_back(measure(timing, "inspect", connections, 1, "commands", pick, [&]
+										  { inspector.exec(command); }));
+			}
+			std::filesystem::remove(path);
+		}
+	}
+	catch (const std::exception &ex)
+	{
+		std::filesystem::remove(path);
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+
+	std::ofstream file;
+	if (options.count("output"))
+	{
+		file.open(options.at("output").as<std::string>());
+		if (!file.is_open())
+		{
+			std::cerr << "Failed to open output file" << std::endl;
+			return 1;
+		}
+	}
+	std::ostream &output = options.count("output") ? file : std::cout;
+
+	output << "{\n\t\"version\": \"" << VERSION << "\",\n\t\"seed\": " << seed << ",\n\t\"latencyUnit\": \"ns\",\n\t\"peakRssUnit\": \"KiB\",\n\t\"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		output << "\t\t" << json(results[i]) << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	output << "\t],\n\t\"peakRss\": " << peak_rss() << "\n}" << std::endl;
+
+	if (options.count("compare"))
+	{
+		try
+		{
+			const size_t regressions = compare(results, options.at("compare").as<std::string>(), options.at("threshold").as<double>());
+			if (regressions > 0)
+			{
+				std::cerr << regressions << " regression" << (regressions == 1 ? "" : "s") << std::endl;
+				return 1;
+			}
+		}
+		catch (const std::exception &ex)
+		{
+			std::cerr << ex.what() << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef H_commands
+#define H_commands
+
+/*
+The subcommands of tempest, as functions taking the arguments of their tempest-<name> binary.
+argv[0] is the name the command was called by, and options start at argv[1].
+The tempest binary calls them in-process, and each tempest-<name> binary only calls one.
+*/
+namespace commands
+{
+	using Main = int (*)(int argc, char **argv);
+
+	int bench(int argc, char **argv);
+	int dump(int argc, char **argv);
+	int inspect(int argc, char **argv);
+	int run(int argc, char **argv);
+	int serve(int argc, char **argv);
+	int touch(int argc, char **argv);
+	int train(int argc, char **argv);
+}
+
+#endif
@@ -0,0 +1,240 @@
+#include "commands.hpp"
+#include "../core/File.hpp"
+#include "../core/NeuralNetwork.hpp"
+#include "../core/NetworkStream.hpp"
+#include <boost/program_options.hpp>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+
+namespace po = boost::program_options;
+
+int commands::dump(int argc, char **argv)
+{
+	po::variables_map options;
+	po::options_description cli("Options");
+	cli.add_options()
+		("help,h", "Display help message")
+		("debug", "Show verbose/debug messages")
+		("output,o", po::value<std::string>()->default_value("")->value_name("path"), "Output file")
+		("format,f", po::value<std::string>()->default_value("text")->value_name("format"), "Output format (text, dot, stats)")
+		("detail,d", po::value<unsigned char>()->default_value(2)->value_name("level"), "How much detail to output");
+
+	po::options_description positionals("Options");
+	positionals.add_options()("input", po::value<std::string>(), "Input file");
+	po::positional_options_description _positionals;
+	_positionals.add("input", 1);
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(po::options_description().add(cli).add(positionals)).positional(_positionals).run(), options);
+	}
+	catch( const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	po::notify(options);
+
+	if (options.count("help"))
+	{
+		std::cout << "Usage: <input> [options]" << std::endl
+				  << cli << std::endl;
+		return 0;
+	}
+
+	if (!options.count("input"))
+	{
+		std::cerr << "No input file specified." << std::endl;
+		return 1;
+	}
+
+	const std::string path = options.at("input").as<std::string>();
+	const std::string output = options.at("output").as<std::string>();
+	const std::string format = options.at("format").as<std::string>();
+	const unsigned char detailLevel = options.at("detail").as<unsigned char>();
+	if (format != "text" && format != "stats" && (output.empty() || output == "/proc/stdout"))
+	{
+		std::cerr << "No output file specified." << std::endl;
+		return 1;
+	}
+	try
+	{
+		std::cout << "Dump of " << path << ":\n";
+
+		// networks are streamed, so files larger than memory can be dumped
+		File file;
+		file.readHeader(path);
+		if (file.type() != FileType::NETWORK)
+		{
+			file.readPath(path);
+		}
+
+		std::cout << "Header: \nmagic: " << file.magic() << "\n";
+		const unsigned char _type = file.header.type;
+		const std::string type = (_type < maxFileType) ? fileTypes.at(_type) : "Unknown (" + std::to_string(_type) + ")";
+		std::cout << "type: " << type << "\nversion: " << std::to_string(file.version()) << std::endl;
+
+		if (file.type() == FileType::NONE)
+		{
+			std::cout << "No data" << std::endl;
+			return 0;
+		}
+
+		std::ostream &out = output.empty() ? std::cout : *(new std::ofstream(output));
+
+		NetworkChunk chunk;
+		std::unique_ptr<NetworkReader> reader;
+		if (file.type() == FileType::NETWORK)
+		{
+			reader = std::make_unique<NetworkReader>(path);
+		}
+
+		if (format == "gv" || format == "dot")
+		{
+
+			switch (file.type())
+			{
+			case FileType::NONE:
+				out << "";
+				break;
+			case FileType::NETWORK:
+				out << "digraph net_" << reader->id << " {\n";
+				while (reader->next(chunk))
+				{
+					for (const MappedFile::Record &neuron : chunk.neurons)
+					{
+						const std::span<const Neuron::ConnectionData> outputs = chunk.outputs(neuron);
+						out << "\tn_" << neuron.id << " -> {";
+						for(size_t i = 0; i < outputs.size(); i++)
+						{
+							if (i != 0)
+							{
+								out << ',';
+							}
+							out << "n_" << outputs[i].neuron;
+						}
+						out << "}\n";
+					}
+				}
+				out << "}";
+				break;
+			case FileType::PARTIAL:
+				out << "Not supported" << std::endl;
+				break;
+			case FileType::FULL:
+				out << "Not supported" << std::endl;
+				break;
+			}
+		}
+
+		else if (format == "text")
+		{
+
+			if (file.type() == FileType::NONE)
+			{
+				out << "";
+			}
+			if (file.type() == FileType::NETWORK)
+			{
+				out << "Network " << reader->id << " (" << reader->size << " neurons)" << (detailLevel > 0) << std::endl;
+				out.flush();
+				while (reader->next(chunk))
+				{
+					for (const MappedFile::Record &neuron : chunk.neurons)
+					{
+						const std::span<const Neuron::ConnectionData> outputs = chunk.outputs(neuron);
+						uint8_t type = neuron.type;
+						out << "\tNeuron " << neuron.id << " (";
+						out << (type < maxNeuronType) ? neuronTypes.at(type) : "Unknown Type (" + std::to_string(type) + ")";
+						out << ", " << outputs.size() << " outputs)" << (detailLevel > 1 && outputs.size() > 0 ? ":" : "");
+						if (detailLevel > 1)
+						{
+							for(size_t i = 0; i < outputs.size(); i++)
+							{
+								const Neuron::ConnectionData &conn = outputs[i];
+								if (i != 0)
+								{
+									out << ',';
+								}
+								out << "n_" << conn.neuron;
+								if (detailLevel > 2)
+								{
+									out << " (" << conn.strength << "," << conn.plasticityRate << "," << conn.plasticityThreshold << "," << conn.reliability << ")";
+								}
+							}
+						}
+
+						out << '\n';
+					}
+				}
+			}
+			if (file.type() == FileType::PARTIAL)
+			{
+				out << "Not supported" << std::endl;
+			}
+			if (file.type() == FileType::FULL)
+			{
+				out << "Not supported" << std::endl;
+			}
+		}
+
+		else if (format == "stats")
+		{
+			if (file.type() != FileType::NETWORK)
+			{
+				out << "Not supported" << std::endl;
+			}
+			else
+			{
+				std::array<size_t, maxNeuronType + 1> types{}; // the last is for unknown types
+				size_t neurons = 0, connections = 0, maxOutputs = 0, selfConnections = 0;
+				while (reader->next(chunk))
+				{
+					for (const MappedFile::Record &neuron : chunk.neurons)
+					{
+						types[std::min<size_t>(neuron.type, maxNeuronType)]++;
+						neurons++;
+						connections += neuron.count;
+						maxOutputs = std::max<size_t>(maxOutputs, neuron.count);
+						for (const Neuron::ConnectionData &conn : chunk.outputs(neuron))
+						{
+							selfConnections += conn.neuron == neuron.id;
+						}
+					}
+				}
+
+				out << "Network " << reader->id << " (" << reader->name << ", " << reader->activation << ")\n"
+					<< "neurons: " << neurons << "\n";
+				for (size_t type = 0; type < maxNeuronType; type++)
+				{
+					out << "\t" << neuronTypes.at(type) << ": " << types[type] << "\n";
+				}
+				if (types[maxNeuronType] > 0)
+				{
+					out << "\tunknown: " << types[maxNeuronType] << "\n";
+				}
+				out << "connections: " << connections << "\n"
+					<< "outputs per neuron: " << (neurons > 0 ? static_cast<double>(connections) / neurons : 0) << " mean, " << maxOutputs << " max\n"
+					<< "self connections: " << selfConnections << std::endl;
+			}
+		}
+
+		else
+		{
+			std::cerr << "Format not supported" << std::endl;
+		}
+
+		out.flush();
+		return 0;
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
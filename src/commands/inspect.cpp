@@ -0,0 +1,146 @@
+#include "commands.hpp"
+#include "../core/File.hpp"
+#include "../core/NeuralNetwork.hpp"
+#include "../core/Inspector.hpp"
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <numeric>
+#include <chrono>
+#include <unistd.h>
+
+namespace po = boost::program_options;
+
+int commands::inspect(int argc, char **argv)
+{
+	// Command-line options
+	po::options_description cli("Options");
+	cli.add_options()
+		("help,h", "Display help message")
+		("debug", "Show verbose/debug messages")
+		("no-load", "Do not automatically load the input file")
+		("script,s", po::value<std::string>()->value_name("path"), "Run the commands in a script instead of prompting for them (- for stdin, the default when stdin is not a terminal)")
+		("quiet,q", "Do not show the results of script commands")
+		("dry-run,n", "Do not write the file for the script's write commands without a path");
+	po::options_description _positionals;
+	_positionals.add_options()("input", po::value<std::string>()->value_name("path"), "Input file");
+	po::positional_options_description positionals;
+	positionals.add("input", 1);
+	po::variables_map options;
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(po::options_description().add(cli).add(_positionals)).positional(positionals).run(), options);
+	}
+	catch( const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	po::notify(options);
+
+	if (options.count("help"))
+	{
+		std::cout << "Usage: [input] [options]" << std::endl
+				  << cli << std::endl;
+		return 0;
+	}
+
+	Inspector inspector;
+
+	std::string script_path;
+	if (options.count("script"))
+	{
+		script_path = options.at("script").as<std::string>();
+	}
+	else if (!isatty(STDIN_FILENO))
+	{
+		script_path = "-";
+	}
+
+	std::string path;
+	
+	if (options.count("input"))
+	{
+		path = options.at("input").as<std::string>();
+	}
+	else if (!script_path.empty())
+	{
+		std::cerr << "No input file" << std::endl;
+		return 1;
+	}
+	else
+	{
+		std::cout << "File: ";
+		std::getline(std::cin >> std::ws, path);
+	}
+	
+	inspector.path(path);
+
+	try
+	{
+		if (!options.count("no-load"))
+		{
+			inspector.load();
+		}
+
+		if (!script_path.empty())
+		{
+			auto start = std::chrono::steady_clock::now();
+			Inspector::Script script;
+			if (script_path == "-")
+			{
+				script = Inspector::Script::Parse(std::cin);
+			}
+			else
+			{
+				std::ifstream script_file(script_path);
+				if (!script_file)
+				{
+					throw std::runtime_error("Failed to open script: " + script_path);
+				}
+				script = Inspector::Script::Parse(script_file);
+			}
+
+			const Inspector::Outcome outcome = inspector.run(std::move(script), options.count("quiet") ? nullptr : &std::cout, !options.count("dry-run"), &std::cerr);
+			std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+			if (!options.count("quiet"))
+			{
+				std::cout << "Ran " << outcome.commands << " commands in " << time.count() << "s" << std::endl;
+			}
+			if (outcome.failures > 0)
+			{
+				std::cerr << outcome.failures << " commands failed" << std::endl;
+				return 1;
+			}
+			return 0;
+		}
+
+		std::cout << "Inspecting " << path << std::endl;
+		do
+		{
+			std::string raw_command;
+			std::string scope_path = inspector.stringify_scope();
+			std::cout << "["
+					  << inspector.scope.active
+					  << (scope_path == "" ? "" : " #")
+					  << scope_path
+					  << "]? ";
+			std::getline(std::cin >> std::ws, raw_command);
+			std::cout << inspector.exec(raw_command) << std::endl;
+		}
+		while (inspector.command() != "quit");
+		return 0;
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << err.what() << std::endl;
+		if (options.count("debug"))
+		{
+			throw err;
+		}
+		return 1;
+	}
+}
@@ -0,0 +1,563 @@
+#include "commands.hpp"
+#include "../core/File.hpp"
+#include "../core/NeuralNetwork.hpp"
+#include "../core/MappedFile.hpp"
+#include <boost/program_options.hpp>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+
+namespace po = boost::program_options;
+
+namespace
+{
+	// Shows sampled outputs while running, with how many times outputs have been reached
+	void showOutputs(const Observer &observer, std::span<const float> outputs)
+	{
+		bool first = true;
+		std::cout << "\r" << "[" << observer.notifications << "] ";
+		for(const float output : outputs)
+		{
+			if(!first)
+			{
+				std::cout << ",";
+			}
+			first = false;
+			std::cout << output;
+		}
+		std::cout.flush();
+	}
+
+	// rows run together by Plan::runBatch
+	constexpr size_t batchWidth = 256;
+
+	enum class RowFormat
+	{
+		CSV,
+		BINARY,
+	};
+
+	// values in binary rows are little-endian
+	float littleEndian(float value)
+	{
+		if constexpr (std::endian::native == std::endian::big)
+		{
+			return std::bit_cast<float>(__builtin_bswap32(std::bit_cast<uint32_t>(value)));
+		}
+		return value;
+	}
+
+	/*
+	Reads rows of inputs for --batch, a block at a time.
+	CSV rows are lines of values separated by commas, and binary rows are one float per input neuron.
+	*/
+	class RowReader
+	{
+	public:
+		// for CSV rows with fewer values than inputs, which are an error without one
+		std::optional<float> defaultValue;
+
+		RowReader(std::istream &in, RowFormat format, size_t size) : in(in), format(format), size(size) {}
+
+		// Reads up to count rows, which are fewer only at the end of the input
+		NeuralNetwork::Batch read(size_t count)
+		{
+			NeuralNetwork::Batch rows;
+			rows.reserve(count);
+			if (format == RowFormat::BINARY)
+			{
+				// rows of no floats can not be told apart
+				if (size == 0)
+				{
+					throw std::runtime_error("Binary batch inputs need a network with inputs");
+				}
+				buffer.resize(count * size);
+				in.read(reinterpret_cast<char *>(buffer.data()), buffer.size() * sizeof(float));
+				const size_t read = in.gcount() / sizeof(float);
+				if (in.gcount() % (size * sizeof(float)) != 0)
+				{
+					throw std::runtime_error("Batch inputs end in the middle of a row");
+				}
+				for (size_t start = 0; start < read; start += size)
+				{
+					NeuralNetwork::Values &row = rows.emplace_back(size);
+					std::transform(buffer.data() + start, buffer.data() + start + size, row.begin(), littleEndian);
+				}
+				return rows;
+			}
+
+			while (rows.size() < count && std::getline(in, text))
+			{
+				line++;
+				if (text.find_first_not_of(" \t\r") == std::string::npos)
+				{
+					continue;
+				}
+				rows.push_back(_parse());
+			}
+			return rows;
+		}
+
+	protected:
+		std::istream &in;
+		RowFormat format;
+		size_t size;
+		std::vector<float> buffer;
+		std::string text;
+		size_t line = 0;
+		bool warned = false;
+
+		NeuralNetwork::Values _parse()
+		{
+			NeuralNetwork::Values row;
+			row.reserve(size);
+			const char *position = text.data(), *end = text.data() + text.size();
+			auto skipSpace = [&]
+			{
+				while (position < end && (*position == ' ' || *position == '\t' || *position == '\r'))
+				{
+					position++;
+				}
+			};
+			while (true)
+			{
+				skipSpace();
+				float value;
+				const auto [next, error] = std::from_chars(position, end, value);
+				if (error != std::errc())
+				{
+					throw std::runtime_error("Invalid value on line " + std::to_string(line) + " of batch inputs");
+				}
+				row.push_back(value);
+				position = next;
+				skipSpace();
+				if (position == end)
+				{
+					break;
+				}
+				if (*position++ != ',')
+				{
+					throw std::runtime_error("Invalid value on line " + std::to_string(line) + " of batch inputs");
+				}
+			}
+
+			if (row.size() > size)
+			{
+				_warn("more values than input neurons. Extra values discarded.");
+				row.resize(size);
+			}
+			if (row.size() < size)
+			{
+				if (!defaultValue)
+				{
+					throw std::runtime_error("Fewer values than input neurons on line " + std::to_string(line) + " of batch inputs");
+				}
+				_warn("less values than input neurons. Missing values defaulted.");
+				row.resize(size, *defaultValue);
+			}
+			return row;
+		}
+
+		// warns about the first row that does not fit, rather than every one
+		void _warn(const std::string &message)
+		{
+			if (!warned)
+			{
+				std::cerr << "warning: line " << line << " of batch inputs has " << message << std::endl;
+				warned = true;
+			}
+		}
+	};
+
+	void writeRows(std::ostream &out, RowFormat format, const NeuralNetwork::Batch &rows)
+	{
+		if (format == RowFormat::BINARY)
+		{
+			for (const NeuralNetwork::Values &row : rows)
+			{
+				for (const float value : row)
+				{
+					const float stored = littleEndian(value);
+					out.write(reinterpret_cast<const char *>(&stored), sizeof(float));
+				}
+			}
+			return;
+		}
+
+		for (const NeuralNetwork::Values &row : rows)
+		{
+			for (size_t i = 0; i < row.size(); i++)
+			{
+				out << (i ? "," : "") << row[i];
+			}
+			out << '\n';
+		}
+	}
+
+	/*
+	Streams the rows of --batch through a plan, a block of rows at a time.
+	The next block is read and the last one written while a block runs, so the run is bound by the plan rather than by I/O.
+	*/
+	int runBatch(Plan &plan, const po::variables_map &options, std::ostream &info, size_t block, unsigned maxDepth, const std::string &statsFormat, double readTime, double compileTime)
+	{
+		const std::string path = options.at("batch").as<std::string>(), outputPath = options.at("output").as<std::string>();
+		std::string format = options.at("format").as<std::string>();
+		if (format == "auto")
+		{
+			format = path == "-" || path.ends_with(".csv") || path.ends_with(".txt") ? "csv" : "binary";
+		}
+		if (format != "csv" && format != "binary")
+		{
+			std::cerr << "Invalid format: " << format << std::endl;
+			return 1;
+		}
+		const RowFormat rowFormat = format == "csv" ? RowFormat::CSV : RowFormat::BINARY;
+
+		if (plan.inputs.empty())
+		{
+			std::cerr << "The network has no input neurons" << std::endl;
+			return 1;
+		}
+
+		std::ifstream inputFile;
+		if (path != "-")
+		{
+			inputFile.open(path, std::ios::binary);
+			if (!inputFile.is_open())
+			{
+				std::cerr << "Failed to open " << path << std::endl;
+				return 1;
+			}
+		}
+		std::ofstream outputFile;
+		if (outputPath != "-")
+		{
+			outputFile.open(outputPath, std::ios::binary | std::ios::trunc);
+			if (!outputFile.is_open())
+			{
+				std::cerr << "Failed to open " << outputPath << std::endl;
+				return 1;
+			}
+		}
+		std::istream &input = path == "-" ? std::cin : inputFile;
+		std::ostream &output = outputPath == "-" ? std::cout : outputFile;
+		output << std::setprecision(std::numeric_limits<float>::max_digits10);
+
+		RowReader reader(input, rowFormat, plan.inputs.size());
+		if (!options.count("no-defaults"))
+		{
+			reader.defaultValue = options.at("default").as<float>();
+		}
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t numRows = 0;
+		NeuralNetwork::Batch rows = reader.read(block);
+		std::future<void> writing;
+		while (!rows.empty())
+		{
+			std::future<NeuralNetwork::Batch> reading = std::async(std::launch::async, [&]
+																   { return reader.read(block); });
+			NeuralNetwork::Batch results = plan.runBatch(rows, maxDepth, batchWidth);
+			numRows += rows.size();
+			if (writing.valid())
+			{
+				writing.get();
+			}
+			writing = std::async(std::launch::async, [&output, rowFormat, results = std::move(results)]
+								 { writeRows(output, rowFormat, results); });
+			rows = reading.get();
+		}
+		if (writing.valid())
+		{
+			writing.get();
+		}
+		output.flush();
+		const double runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (statsFormat == "json")
+		{
+			info << "{\"rows\":" << numRows
+				 << ",\"rowsPerSecond\":" << numRows / runTime
+				 << ",\"time\":{\"read\":" << readTime
+				 << ",\"compile\":" << compileTime
+				 << ",\"run\":" << runTime << "}}" << std::endl;
+		}
+		else if (statsFormat == "text")
+		{
+			info << "Rows: " << numRows << " (" << numRows / runTime << " per second)"
+				 << "\nTime: read " << readTime * 1000 << "ms, compile " << compileTime * 1000
+				 << "ms, run " << runTime * 1000 << "ms" << std::endl;
+		}
+		return 0;
+	}
+}
+
+int commands::run(int argc, char **argv)
+{
+	po::variables_map options;
+	po::options_description cli("Options");
+	cli.add_options()
+		("help,h", "Display help message")
+		("debug", "Show verbose/debug messages")
+		("inputs,i", po::value<NeuralNetwork::Values>()->value_name("values")->multitoken(), "Input values")
+		("default", po::value<float>()->default_value(0)->value_name("value"), "Default value for missing inputs")
+		("no-defaults", "Do not default missing inputs")
+		("max-depth,d", po::value<unsigned>()->default_value(1000)->value_name("depth"), "The maximum depth of Neurons updates")
+		("propagation,p", po::value<std::string>()->default_value("recursive")->value_name("mode"), "How updates propagate through the network (recursive, frontier)")
+		("threads,t", po::value<unsigned>()->default_value(1)->value_name("count"), "Number of threads for frontier propagation (0 for all cores)")
+		("precision,q", po::value<std::string>()->default_value("none")->value_name("type"), "Precision of connection weights when running (none, fp16, int8)")
+		("sample-every", po::value<uint64_t>()->default_value(1000)->value_name("count"), "With --debug, show outputs every N times they are reached")
+		("sample-interval", po::value<unsigned>()->default_value(0)->value_name("ms"), "With --debug, show outputs at most once per interval")
+		("on-change", "With --debug, only show outputs that changed")
+		("batch,b", po::value<std::string>()->value_name("path"), "Run every row of a file of inputs instead of --inputs, or - for stdin")
+		("format,f", po::value<std::string>()->default_value("auto")->value_name("format"), "Format of batch inputs and outputs (auto, csv, binary). auto is csv for - and files ending in .csv or .txt, binary otherwise")
+		("output,o", po::value<std::string>()->default_value("-")->value_name("path"), "Where batch outputs are written, in the same format as the inputs")
+		("block", po::value<size_t>()->default_value(0)->value_name("rows"), "Number of batch rows read and run at a time (0 for enough to keep every thread busy)")
+		("stats,s", po::value<std::string>()->implicit_value("text")->value_name("format"), "Print what the run cost (text, json)");
+
+	po::options_description positionals("Options");
+	positionals.add_options()("network", po::value<std::string>(), "Network file to run");
+	po::positional_options_description _positionals;
+	_positionals.add("network", 1);
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(po::options_description().add(cli).add(positionals)).positional(_positionals).run(), options);
+	}
+	catch( const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	po::notify(options);
+
+	if (options.count("help"))
+	{
+		std::cout << "Usage: <network> [options]" << std::endl
+				  << cli << std::endl;
+		return 0;
+	}
+
+	if (!options.count("network"))
+	{
+		std::cerr << "No network file specified." << std::endl;
+		return 1;
+	}
+
+	const std::string path = options.at("network").as<std::string>();
+	debug = options.count("debug");
+
+	// with outputs written to stdout, everything else goes to stderr
+	const bool batch = options.count("batch");
+	const std::string batchPath = batch ? options.at("batch").as<std::string>() : "";
+	std::ostream &info = batch && options.at("output").as<std::string>() == "-" ? std::cerr : std::cout;
+
+	const std::string statsFormat = options.count("stats") ? options.at("stats").as<std::string>() : "";
+	if (!statsFormat.empty() && statsFormat != "text" && statsFormat != "json")
+	{
+		std::cerr << "Invalid stats format: " << statsFormat << std::endl;
+		return 1;
+	}
+
+	// wall time of reading and compiling the network, in seconds
+	using clock = std::chrono::steady_clock;
+	clock::time_point start = clock::now();
+	double readTime = 0, compileTime = 0;
+	auto lap = [&](double &phase)
+	{
+		const clock::time_point now = clock::now();
+		phase = std::chrono::duration<double>(now - start).count();
+		start = now;
+	};
+
+	try
+	{
+		info << "Reading " << path << "..." << std::endl;
+
+		File file;
+		file.readHeader(path);
+
+		if (file.type() != FileType::NETWORK && file.type() != FileType::PARTIAL)
+		{
+			std::cerr << "Not a network" << std::endl;
+			return 1;
+		}
+
+		// networks in mapped files are compiled in place, others are read and compiled
+		std::unique_ptr<MappedFile> mapped;
+		std::unique_ptr<Plan> mappedPlan;
+		Plan *plan;
+		if (file.mapped())
+		{
+			mapped = std::make_unique<MappedFile>(path, sizeof(File::Header));
+			lap(readTime);
+			log_debug("Compiling...");
+			mappedPlan = std::make_unique<Plan>(*mapped);
+			plan = mappedPlan.get();
+		}
+		else
+		{
+			file.readPath(path);
+			lap(readTime);
+			log_debug("Compiling...");
+			plan = &file.network->compile();
+		}
+		lap(compileTime);
+
+		const unsigned maxDepth = options.at("max-depth").as<unsigned>();
+
+		const std::string propagation = options.at("propagation").as<std::string>();
+		auto propagation_it = std::find(propagations.begin(), propagations.end(), propagation);
+		if (propagation_it == propagations.end())
+		{
+			std::cerr << "Invalid propagation: " << propagation << std::endl;
+			return 1;
+		}
+
+		const unsigned threads = options.at("threads").as<unsigned>();
+		const Propagation propagationMode = static_cast<Propagation>(std::distance(propagations.begin(), propagation_it));
+		if (threads != 1 && propagationMode != Propagation::FRONTIER && !batch)
+		{
+			std::cerr << "Multiple threads require frontier propagation" << std::endl;
+			return 1;
+		}
+
+		const std::string precision = options.at("precision").as<std::string>();
+		auto precision_it = std::find(quantizations.begin(), quantizations.end(), precision);
+		if (precision_it == quantizations.end())
+		{
+			std::cerr << "Invalid precision: " << precision << std::endl;
+			return 1;
+		}
+
+		plan->propagation = propagationMode;
+		if (threads != 1)
+		{
+			plan->pool = std::make_shared<ThreadPool>(threads > 0 ? threads : std::thread::hardware_concurrency());
+		}
+
+		const Quantization precisionMode = static_cast<Quantization>(std::distance(quantizations.begin(), precision_it));
+		if (batch)
+		{
+			log_debug("Quantizing...");
+			plan->quantize(precisionMode);
+			info << "Running..."
+				 << "\nWith batch: " << batchPath
+				 << "\nWith maximum depth: " << maxDepth
+				 << "\nWith propagation: " << propagation
+				 << "\nWith threads: " << (plan->pool ? plan->pool->size() : 1)
+				 << "\nWith precision: " << precision << std::endl;
+			const size_t block = options.at("block").as<size_t>();
+			return runBatch(*plan, options, info, block > 0 ? block : batchWidth * 4 * (plan->pool ? plan->pool->size() : 1), maxDepth, statsFormat, readTime, compileTime);
+		}
+
+		NeuralNetwork::Values inputs = options.at("inputs").as<NeuralNetwork::Values>();
+
+		const size_t numInputNeurons = plan->inputs.size();
+
+		if(inputs.size() > numInputNeurons)
+		{
+			std::cerr << "warning: more inputs provided than input neurons. Extra inputs discarded." << std::endl;
+			inputs.resize(numInputNeurons);
+		}
+
+		const bool noDefaults = options.count("no-defaults");
+		if(inputs.size() < numInputNeurons)
+		{
+			std::cerr << (noDefaults ? "error" : "warning") << ": less inputs provided than input neurons. ";
+			if(noDefaults)
+			{
+				std::cerr << "No defaults allowed, exiting." << std::endl;
+				return 1;
+			}
+			const float defaultValue = options.at("default").as<float>();
+			std::cerr << " Missing inputs defaulted." << std::endl;
+			inputs.resize(numInputNeurons, defaultValue);
+		}
+
+		// the inputs are run at both precisions, so the error of the quantized weights is known
+		Plan::Calibration calibration;
+		if (precisionMode != Quantization::NONE)
+		{
+			log_debug("Calibrating...");
+			calibration = plan->calibrate(precisionMode, {inputs}, maxDepth);
+		}
+
+		std::cout << "Running..."
+		<< "\nWith maximum depth: " << maxDepth
+		<< "\nWith propagation: " << propagation
+		<< "\nWith threads: " << (plan->pool ? plan->pool->size() : 1)
+		<< "\nWith precision: " << precision;
+		if (precisionMode != Quantization::NONE)
+		{
+			std::cout << " (mean error " << calibration.meanError << ", max error " << calibration.maxError << " from full precision)";
+		}
+		std::cout << std::endl;
+
+		// outputs are only observed when debugging, so other runs are not slowed down
+		Observer observer;
+		observer.callback = [&](std::span<const float> outputs)
+		{ showOutputs(observer, outputs); };
+		observer.every = options.at("sample-every").as<uint64_t>();
+		observer.interval = std::chrono::milliseconds(options.at("sample-interval").as<unsigned>());
+		observer.onChange = options.count("on-change");
+
+		Plan::Stats stats;
+		NeuralNetwork::Values outputs = plan->run(inputs, maxDepth, debug ? &observer : nullptr, statsFormat.empty() ? nullptr : &stats);
+		std::cout << "\r" << std::flush;
+		bool first = true;
+		for(const float output : outputs)
+		{
+			if(!first)
+			{
+				std::cout << ",";
+			}
+			first = false;
+			std::cout << output;
+		}
+
+		std::cout << std::endl;
+
+		if (statsFormat == "json")
+		{
+			std::cout << "{\"updates\":" << stats.updates
+					  << ",\"edges\":" << stats.edges
+					  << ",\"revisits\":" << stats.revisits
+					  << ",\"notifications\":" << stats.notifications
+					  << ",\"cutoffs\":" << stats.cutoffs
+					  << ",\"depth\":" << stats.depth
+					  << ",\"maxDepth\":" << maxDepth
+					  << ",\"time\":{\"read\":" << readTime
+					  << ",\"compile\":" << compileTime
+					  << ",\"load\":" << stats.load
+					  << ",\"update\":" << stats.update
+					  << ",\"store\":" << stats.store << "}}" << std::endl;
+		}
+		else if (statsFormat == "text")
+		{
+			std::cout << "Updates: " << stats.updates << " (" << stats.revisits << " revisits)"
+					  << "\nEdges traversed: " << stats.edges
+					  << "\nDepth reached: " << stats.depth << " of " << maxDepth
+					  << "\nCut off by maximum depth: " << stats.cutoffs
+					  << "\nOutput notifications: " << stats.notifications
+					  << "\nTime: read " << readTime * 1000 << "ms, compile " << compileTime * 1000
+					  << "ms, load " << stats.load * 1000 << "ms, update " << stats.update * 1000
+					  << "ms, store " << stats.store * 1000 << "ms" << std::endl;
+		}
+
+		return 0;
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
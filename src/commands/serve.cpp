@@ -0,0 +1,187 @@
+#include "commands.hpp"
+#include "../core/Server.hpp"
+#include <boost/program_options.hpp>
+#include <condition_variable>
+#include <csignal>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <thread>
+
+namespace po = boost::program_options;
+
+int commands::serve(int argc, char **argv)
+{
+	po::variables_map options;
+	po::options_description cli("Options");
+	cli.add_options()
+		("help,h", "Display help message")
+		("debug", "Show verbose/debug messages")
+		("socket,s", po::value<std::string>()->default_value("/tmp/tempest.sock")->value_name("path"), "Unix socket to listen on")
+		("max-depth,d", po::value<unsigned>()->default_value(1000)->value_name("depth"), "The maximum depth of Neurons updates")
+		("propagation,p", po::value<std::string>()->default_value("recursive")->value_name("mode"), "How updates propagate through the networks (recursive, frontier)")
+		("threads,t", po::value<unsigned>()->default_value(1)->value_name("count"), "Number of threads each network's batches run on (0 for all cores)")
+		("precision,q", po::value<std::string>()->default_value("none")->value_name("type"), "Precision of connection weights when running (none, fp16, int8)")
+		("max-batch,b", po::value<size_t>()->default_value(256)->value_name("requests"), "Most requests to a network run as one batch")
+		("batch-wait,w", po::value<unsigned>()->default_value(0)->value_name("us"), "How long a batch waits for more requests, in microseconds")
+		("watch", po::value<unsigned>()->implicit_value(1)->value_name("seconds"), "Reload network files when they are modified, checking at this interval");
+
+	po::options_description positionals("Options");
+	positionals.add_options()("networks", po::value<std::vector<std::string>>()->multitoken(), "Network files to serve, numbered from 0 in order");
+	po::positional_options_description _positionals;
+	_positionals.add("networks", -1);
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(po::options_description().add(cli).add(positionals)).positional(_positionals).run(), options);
+	}
+	catch (const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	po::notify(options);
+
+	if (options.count("help"))
+	{
+		std::cout << "Usage: <networks...> [options]" << std::endl
+				  << "Send SIGHUP to reload every network" << std::endl
+				  << cli << std::endl;
+		return 0;
+	}
+
+	if (!options.count("networks"))
+	{
+		std::cerr << "No network files specified." << std::endl;
+		return 1;
+	}
+
+	debug = options.count("debug");
+
+	const std::string propagation = options.at("propagation").as<std::string>();
+	auto propagation_it = std::find(propagations.begin(), propagations.end(), propagation);
+	if (propagation_it == propagations.end())
+	{
+		std::cerr << "Invalid propagation: " << propagation << std::endl;
+		return 1;
+	}
+
+	const std::string precision = options.at("precision").as<std::string>();
+	auto precision_it = std::find(quantizations.begin(), quantizations.end(), precision);
+	if (precision_it == quantizations.end())
+	{
+		std::cerr << "Invalid precision: " << precision << std::endl;
+		return 1;
+	}
+
+	const size_t maxBatch = options.at("max-batch").as<size_t>();
+	if (maxBatch == 0)
+	{
+		std::cerr << "Batches need at least one request" << std::endl;
+		return 1;
+	}
+
+	// signals are taken by one thread, so the others are never interrupted. SIGUSR1 tells that thread to finish
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGHUP);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	const std::vector<std::string> paths = options.at("networks").as<std::vector<std::string>>();
+	const unsigned threads = options.at("threads").as<unsigned>();
+	std::unique_ptr<Server> server;
+	try
+	{
+		log_debug("Reading ", paths.size(), " networks...");
+		server = std::make_unique<Server>(paths, options.at("max-depth").as<unsigned>(),
+										  static_cast<Propagation>(std::distance(propagations.begin(), propagation_it)),
+										  static_cast<Quantization>(std::distance(quantizations.begin(), precision_it)),
+										  threads > 0 ? threads : std::thread::hardware_concurrency());
+		server->maxBatch = maxBatch;
+		server->batchWait = std::chrono::microseconds(options.at("batch-wait").as<unsigned>());
+		server->listen(options.at("socket").as<std::string>());
+	}
+	catch (const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+
+	auto reload = [&](size_t network)
+	{
+		try
+		{
+			server->reload(network);
+			std::cout << "Reloaded " << server->path(network) << std::endl;
+		}
+		catch (const std::exception &ex)
+		{
+			std::cerr << "Failed to reload " << server->path(network) << ": " << ex.what() << std::endl;
+		}
+	};
+
+	std::thread signalThread([&]
+							 {
+		int signal;
+		while (sigwait(&signals, &signal) == 0 && signal != SIGUSR1)
+		{
+			if (signal != SIGHUP)
+			{
+				server->stop();
+				continue;
+			}
+			for (size_t network = 0; network < server->size(); network++)
+			{
+				reload(network);
+			}
+		} });
+
+	std::mutex stopMutex;
+	std::condition_variable stopping;
+	bool stopped = false;
+	std::thread watchThread;
+	if (options.count("watch"))
+	{
+		const std::chrono::seconds interval(std::max(1u, options.at("watch").as<unsigned>()));
+		watchThread = std::thread([&, interval]
+								  {
+			std::unique_lock lock(stopMutex);
+			while (!stopping.wait_for(lock, interval, [&]
+									  { return stopped; }))
+			{
+				for (size_t network = 0; network < server->size(); network++)
+				{
+					if (server->modified(network))
+					{
+						reload(network);
+					}
+				}
+			} });
+	}
+
+	std::cout << "Serving on " << options.at("socket").as<std::string>() << std::endl;
+	for (size_t network = 0; network < server->size(); network++)
+	{
+		const std::shared_ptr<const Plan> plan = server->plan(network);
+		std::cout << network << ": " << paths[network] << " (" << plan->size() << " neurons, " << plan->inputs.size() << " inputs, " << plan->outputs.size() << " outputs)" << std::endl;
+	}
+
+	server->serve();
+
+	{
+		std::lock_guard lock(stopMutex);
+		stopped = true;
+	}
+	stopping.notify_all();
+	if (watchThread.joinable())
+	{
+		watchThread.join();
+	}
+	pthread_kill(signalThread.native_handle(), SIGUSR1);
+	signalThread.join();
+	std::cout << "Stopped" << std::endl;
+	return 0;
+}
@@ -0,0 +1,231 @@
+#include "commands.hpp"
+#include "../core/File.hpp"
+#include "../core/NeuralNetwork.hpp"
+#include "../core/Generator.hpp"
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace po = boost::program_options;
+
+int commands::touch(int argc, char **argv)
+{
+
+	po::variables_map options;
+
+	po::options_description cli("Options");
+	cli.add_options()
+		("help,h", "Display help message")
+		("debug", "Show verbose/debug messages")
+		("force,f", "Overwrite files if they already exist")
+		("config,c", po::value<std::string>()->value_name("path"), "Configuration file");
+
+	po::options_description config("Configuration");
+	config.add_options()
+		("type,t", po::value<std::string>()->value_name("type")->default_value("none"), "file type")
+		("version,v", po::value<unsigned int>()->value_name("version")->default_value(File::DefaultVersion), "file version")
+		("neurons,n", po::value<unsigned int>()->value_name("num")->default_value(0), "number of neurons to create per network")
+		("inputs,i", po::value<unsigned int>()->value_name("num")->default_value(0), "number of input neurons")
+		("outputs,o", po::value<unsigned int>()->value_name("num")->default_value(0), "number of output neurons")
+		("mutations,m", po::value<unsigned int>()->value_name("num")->default_value(0), "number of mutations")
+		("connections,e", po::value<size_t>()->value_name("num")->default_value(0), "number of connections to generate in bulk, before mutations")
+		("topology,T", po::value<std::string>()->value_name("model")->default_value("random"), "how generated connections are laid out (random, clumped, small-world, scale-free, layered)")
+		("clumping,g", po::value<float>()->value_name("factor")->default_value(0), "how much neurons should clump together")
+		("rewiring", po::value<float>()->value_name("chance")->default_value(0.1), "chance of a small-world connection going to any neuron")
+		("layers,l", po::value<unsigned>()->value_name("num")->default_value(4), "number of layers of layered networks")
+		("threads,j", po::value<unsigned>()->value_name("count")->default_value(0), "number of threads to generate connections on (0 for all cores)")
+		("activation,a", po::value<std::string>()->value_name("name")->default_value("relu"), "activation function of networks")
+		("seed", po::value<uint64_t>()->value_name("seed"), "random seed, so the same networks can be created again")
+		("shards,s", po::value<size_t>()->value_name("num")->default_value(0), "number of shard files for partial files (0 for one per core)")
+		("quantization,q", po::value<std::string>()->value_name("type")->default_value("none"), "how connection parameters are stored in compact files (none, fp16, int8)");
+	
+	po::options_description _positionals;
+	_positionals.add_options()("output", po::value<std::string>());
+	po::positional_options_description positionals;
+	positionals.add("output", 1);
+
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(po::options_description().add(cli).add(config).add(_positionals)).positional(positionals).run(), options);
+	}
+	catch( const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+
+	if (options.count("config"))
+	{
+		std::string config_path = options.at("config").as<std::string>();
+		std::ifstream config_file(config_path);
+		if (!config_file.is_open())
+		{
+			std::cout << "Failed to open configuration file \"" << config_path << "\", skipping.";
+		}
+		else
+		{
+			po::store(po::parse_config_file(config_file, config), options);
+		}
+	}
+	po::notify(options);
+
+	if (options.count("help"))
+	{
+		std::cout << "Usage: <output> [options]" << std::endl
+				  << cli << config << std::endl;
+		return 0;
+	}
+
+	if (!options.count("output"))
+	{
+		std::cerr << "No output file specified." << std::endl;
+		return 1;
+	}
+	const std::string path = options.at("output").as<std::string>();
+	if (path.empty())
+	{
+		std::cerr << "No output file specified." << std::endl;
+		return 1;
+	}
+
+	debug = options.count("debug");
+
+	if (options.count("seed"))
+	{
+		Random::seed(options.at("seed").as<uint64_t>());
+	}
+	log_debug("Seed: ", Random::seed());
+
+	std::cout << "Creating " << path << "..." << std::endl;
+
+	log_debug("Initializing...");
+	File file;
+
+	file.magic(File::Magic);
+
+	FileType type;
+	unsigned long type_value;
+	std::string type_string = options.at("type").as<std::string>();
+	std::transform(type_string.begin(), type_string.end(), type_string.begin(), ::tolower);
+	auto type_it = std::find(fileTypes.begin(), fileTypes.end(), type_string);
+	if (type_it != fileTypes.end())
+	{
+		type = static_cast<FileType>(std::distance(fileTypes.begin(), type_it));
+	}
+	else
+	{
+		size_t pos;
+		try
+		{
+			type_value = std::stoul(type_string, &pos);
+			if (pos != type_string.length())
+			{
+				std::cout << "Warning: type truncated" << std::endl;
+			}
+
+			if (type_value > std::numeric_limits<uint8_t>::max())
+			{
+				std::cerr << "type to large" << std::endl;
+				return 1;
+			}
+
+			type = static_cast<FileType>(type_value);
+		}
+		catch (const std::exception &ex)
+		{
+			std::cerr << "Invalid type: " << type_string << std::endl;
+			return 1;
+		}
+	}
+	file.type(type);
+
+	File::Version version = options.at("version").as<File::Version>();
+	file.version(version);
+	log_debug("Creating data for file...");
+	NeuralNetwork network;
+	if (type == FileType::NETWORK || type == FileType::PARTIAL)
+	{
+		const std::string activation = options.at("activation").as<std::string>();
+		if (!NeuralNetwork::activations.contains(activation))
+		{
+			std::cerr << "Invalid activation function: " << activation << std::endl;
+			return 1;
+		}
+		network.activation = activation;
+
+		const unsigned num_neurons = options.at("neurons").as<unsigned>();
+		const unsigned num_mutations = options.at("mutations").as<unsigned>();
+		const unsigned num_inputs = options.at("inputs").as<unsigned>();
+		const unsigned num_outputs = options.at("outputs").as<unsigned>();
+		const float clumping = options.at("clumping").as<float>();
+		if(num_neurons < num_inputs + num_outputs)
+		{
+			std::cerr << "The number of input and output neurons exceeds the number of total neurons in the network." << std::endl;
+			return 1;
+		}
+
+		const std::string topology = options.at("topology").as<std::string>();
+		auto topology_it = std::find(topologies.begin(), topologies.end(), topology);
+		if (topology_it == topologies.end())
+		{
+			std::cerr << "Invalid topology: " << topology << std::endl;
+			return 1;
+		}
+
+		Generator generator;
+		generator.neurons = num_neurons;
+		generator.inputs = num_inputs;
+		generator.outputs = num_outputs;
+		generator.connections = options.at("connections").as<size_t>();
+		generator.topology = static_cast<Topology>(std::distance(topologies.begin(), topology_it));
+		generator.clumping = clumping;
+		generator.rewiring = options.at("rewiring").as<float>();
+		generator.layers = options.at("layers").as<unsigned>();
+		const unsigned threads = options.at("threads").as<unsigned>();
+		if (threads != 1)
+		{
+			generator.pool = std::make_shared<ThreadPool>(threads > 0 ? threads : std::thread::hardware_concurrency());
+		}
+		try
+		{
+			generator.generate(network);
+		}
+		catch (const std::exception &ex)
+		{
+			std::cerr << ex.what() << std::endl;
+			return 1;
+		}
+
+		for (auto &[id, neuron] : network)
+		{
+			for (unsigned i = 0; i < num_mutations; i++)
+			{
+				try
+				{
+					neuron.mutate({ 1 - clumping });
+				}
+				catch (const std::exception &)
+				{
+					// e.g. removing a connection that does not exist
+				}
+			}
+		}
+		file.network = &network;
+		file.shards = options.at("shards").as<size_t>();
+
+		const std::string quantization = options.at("quantization").as<std::string>();
+		auto quantization_it = std::find(quantizations.begin(), quantizations.end(), quantization);
+		if (quantization_it == quantizations.end())
+		{
+			std::cerr << "Invalid quantization: " << quantization << std::endl;
+			return 1;
+		}
+		file.quantization = static_cast<Quantization>(std::distance(quantizations.begin(), quantization_it));
+	}
+	log_debug("Writing...");
+	file.writePath(path);
+	std::cout << "Done!" << std::endl;
+	return 0;
+}
@@ -0,0 +1,196 @@
+#include "commands.hpp"
+#include "../core/File.hpp"
+#include "../core/NeuralNetwork.hpp"
+#include "../core/Environment.hpp"
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace po = boost::program_options;
+
+int commands::train(int argc, char **argv)
+{
+	po::variables_map options;
+	po::options_description cli("Options");
+	cli.add_options()
+		("help,h", "Display help message")
+		("debug", "Show verbose/debug messages")
+		("data,D", po::value<std::string>()->value_name("path"), "Training data (CSV rows of inputs followed by expected outputs)")
+		("output,o", po::value<std::string>()->value_name("path"), "Write the trained environment to a file")
+		("best,b", po::value<std::string>()->value_name("path"), "Write the best network to a file")
+		("population,n", po::value<size_t>()->default_value(100)->value_name("num"), "Number of networks when starting from a network")
+		("generations,g", po::value<size_t>()->default_value(10)->value_name("num"), "Number of generations to run")
+		("survivors,s", po::value<float>()->default_value(0.1)->value_name("fraction"), "Fraction of the population kept each generation")
+		("mutations,m", po::value<unsigned>()->default_value(1)->value_name("num"), "Mutations applied to each new network")
+		("clumping", po::value<float>()->default_value(0)->value_name("factor"), "How much new connections should clump together")
+		("max-depth,d", po::value<unsigned>()->default_value(100)->value_name("depth"), "The maximum depth of Neurons updates")
+		("propagation,p", po::value<std::string>()->default_value("frontier")->value_name("mode"), "How updates propagate through the network (recursive, frontier)")
+		("threads,t", po::value<unsigned>()->default_value(0)->value_name("count"), "Number of threads (0 for all cores)")
+		("seed", po::value<uint64_t>()->value_name("seed"), "Random seed, so a run can be repeated");
+
+	po::options_description positionals("Options");
+	positionals.add_options()("input", po::value<std::string>(), "Network or environment file to train");
+	po::positional_options_description _positionals;
+	_positionals.add("input", 1);
+	try
+	{
+		po::store(po::command_line_parser(argc, argv).options(po::options_description().add(cli).add(positionals)).positional(_positionals).run(), options);
+	}
+	catch( const std::exception &ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+	po::notify(options);
+
+	if (options.count("help"))
+	{
+		std::cout << "Usage: <input> [options]" << std::endl
+				  << cli << std::endl;
+		return 0;
+	}
+
+	if (!options.count("input"))
+	{
+		std::cerr << "No input file specified." << std::endl;
+		return 1;
+	}
+
+	if (!options.count("data"))
+	{
+		std::cerr << "No training data specified." << std::endl;
+		return 1;
+	}
+
+	const std::string path = options.at("input").as<std::string>();
+	debug = options.count("debug");
+
+	if (options.count("seed"))
+	{
+		Random::seed(options.at("seed").as<uint64_t>());
+	}
+	log_debug("Seed: ", Random::seed());
+
+	const std::string propagation = options.at("propagation").as<std::string>();
+	auto propagation_it = std::find(propagations.begin(), propagations.end(), propagation);
+	if (propagation_it == propagations.end())
+	{
+		std::cerr << "Invalid propagation: " << propagation << std::endl;
+		return 1;
+	}
+
+	try
+	{
+		std::cout << "Reading " << path << "..." << std::endl;
+
+		File file;
+		file.readPath(path);
+
+		Environment environment;
+		switch (file.type())
+		{
+		case FileType::NETWORK:
+		case FileType::PARTIAL:
+			break;
+		case FileType::FULL:
+			environment.population = std::move(file.environment->population);
+			environment.generation = file.environment->generation;
+			break;
+		default:
+			std::cerr << "Not a network or environment" << std::endl;
+			return 1;
+		}
+
+		NeuralNetwork &reference = file.type() != FileType::FULL ? *file.network : *environment.population.at(0).network;
+		const size_t numInputs = reference.inputs().size(), numOutputs = reference.outputs().size();
+
+		const std::string data_path = options.at("data").as<std::string>();
+		std::ifstream data(data_path);
+		if (!data.is_open())
+		{
+			std::cerr << "Failed to open training data: " << data_path << std::endl;
+			return 1;
+		}
+
+		NeuralNetwork::Batch inputs, expected;
+		std::string line;
+		while (std::getline(data, line))
+		{
+			if (line.empty())
+			{
+				continue;
+			}
+			std::vector<std::string> fields = split(line, ",");
+			if (fields.size() != numInputs + numOutputs)
+			{
+				std::cerr << "Training data rows must have " << numInputs << " inputs and " << numOutputs << " outputs" << std::endl;
+				return 1;
+			}
+			NeuralNetwork::Values row;
+			for (std::string &field : fields)
+			{
+				row.push_back(stonum<float>(field));
+			}
+			inputs.emplace_back(row.begin(), row.begin() + numInputs);
+			expected.emplace_back(row.begin() + numInputs, row.end());
+		}
+		log_debug("Read ", inputs.size(), " rows of training data");
+
+		const unsigned threads = options.at("threads").as<unsigned>();
+		environment.pool = std::make_shared<ThreadPool>(threads > 0 ? threads : std::thread::hardware_concurrency());
+		environment.fitness = Environment::dataset(inputs, expected, options.at("max-depth").as<unsigned>(), static_cast<Propagation>(std::distance(propagations.begin(), propagation_it)));
+		environment.survivors = options.at("survivors").as<float>();
+		environment.mutations = options.at("mutations").as<unsigned>();
+		environment.mutationOptions = {1 - options.at("clumping").as<float>()};
+
+		if (file.type() != FileType::FULL)
+		{
+			const size_t population = options.at("population").as<size_t>();
+			std::cout << "Seeding " << population << " networks..." << std::endl;
+			environment.seed(*file.network, population);
+		}
+		else
+		{
+			environment.evaluate();
+		}
+
+		const size_t generations = options.at("generations").as<size_t>();
+		std::cout << "Training for " << generations << " generations with " << environment.pool->size() << " threads..." << std::endl;
+		environment.evolve(generations, [](const Environment &env)
+						   { std::cout << "Generation " << env.generation << ": best " << env.best().fitness << ", mean " << env.meanFitness() << std::endl; });
+
+		if (options.count("output"))
+		{
+			const std::string output = options.at("output").as<std::string>();
+			File out;
+			out.magic(File::Magic);
+			out.type(FileType::FULL);
+			// environments are always streamed, so mapped and compact versions do not apply to them
+			out.version(file.encoding() == File::Encoding::STREAM ? file.version() : File::StreamVersion);
+			out.environment = &environment;
+			out.writePath(output);
+			std::cout << "Wrote environment to " << output << std::endl;
+		}
+
+		if (options.count("best"))
+		{
+			const std::string output = options.at("best").as<std::string>();
+			File out;
+			out.magic(File::Magic);
+			out.type(FileType::NETWORK);
+			// only a network file's version is known to suit a network
+			out.version(file.type() == FileType::NETWORK ? file.version() : File::DefaultVersion);
+			out.network = environment.best().network.get();
+			out.writePath(output);
+			std::cout << "Wrote best network to " << output << std::endl;
+		}
+
+		return 0;
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << err.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,53 @@
+#include "Activation.hpp"
+
+// Each kernel is compiled for every target and the best one for the CPU is picked when the library is loaded
+#define ACTIVATION_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+
+/*
+	sigmoid and tanh are scalar loops: they call into libm per value, which does not vectorize but keeps their results
+	identical to the scalar functions, so they are not cloned for each target
+*/
+
+void activations::identity([[maybe_unused]] float *values, [[maybe_unused]] size_t count)
+{
+}
+
+ACTIVATION_KERNEL void activations::relu(float *values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = relu(values[i]);
+	}
+}
+
+ACTIVATION_KERNEL void activations::leaky_relu(float *values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = leaky_relu(values[i]);
+	}
+}
+
+void activations::sigmoid(float *values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = sigmoid(values[i]);
+	}
+}
+
+void activations::tanh(float *values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = tanh(values[i]);
+	}
+}
+
+ACTIVATION_KERNEL void activations::softsign(float *values, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = softsign(values[i]);
+	}
+}
@@ -0,0 +1,68 @@
+// Activation functions
+
+#ifndef H_Activation
+#define H_Activation
+
+#include <cmath>
+#include <cstddef>
+
+/*
+An activation function, resolved once per network.
+function is applied to single values, and kernel applies the function in place to many values,
+using the widest vector instructions the CPU supports where the function vectorizes (sigmoid and tanh are scalar).
+*/
+struct Activation
+{
+	using Function = float (*)(float);
+	using Kernel = void (*)(float *values, size_t count);
+
+	Function function = nullptr;
+	Kernel kernel = nullptr;
+
+	float operator()(float x) const
+	{
+		return function(x);
+	}
+};
+
+namespace activations
+{
+	inline float identity(float x)
+	{
+		return x;
+	}
+
+	inline float relu(float x)
+	{
+		return (x > 0) ? x : 0;
+	}
+
+	inline float leaky_relu(float x)
+	{
+		return (x > 0) ? x : 0.01f * x;
+	}
+
+	inline float sigmoid(float x)
+	{
+		return 1 / (1 + std::exp(-x));
+	}
+
+	inline float tanh(float x)
+	{
+		return std::tanh(x);
+	}
+
+	inline float softsign(float x)
+	{
+		return x / (1 + std::abs(x));
+	}
+
+	void identity(float *values, size_t count);
+	void relu(float *values, size_t count);
+	void leaky_relu(float *values, size_t count);
+	void sigmoid(float *values, size_t count);
+	void tanh(float *values, size_t count);
+	void softsign(float *values, size_t count);
+}
+
+#endif
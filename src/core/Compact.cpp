@@ -0,0 +1,56 @@
+#include <cstring>
+#include "Compact.hpp"
+
+// Each kernel is compiled for every target and the best one for the CPU is picked when the library is loaded.
+// The x86-64-v3 level includes F16C, which converts 16-bit floats in vector registers
+#define COMPACT_KERNEL __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+
+COMPACT_KERNEL size_t compact::get_varints(const uint8_t *data, size_t size, uint64_t *values, size_t count)
+{
+	size_t position = 0, i = 0;
+	while (i < count)
+	{
+		if (count - i >= 16 && size - position >= 16)
+		{
+			uint64_t words[2];
+			std::memcpy(words, data + position, sizeof(words));
+			if (((words[0] | words[1]) & 0x8080808080808080ull) == 0)
+			{
+				for (size_t j = 0; j < 16; j++)
+				{
+					values[i + j] = data[position + j];
+				}
+				i += 16;
+				position += 16;
+				continue;
+			}
+		}
+		values[i++] = get_varint(data, size, position);
+	}
+	return position;
+}
+
+// values are copied out of the input, which has no alignment
+
+void compact::dequantize_float(const uint8_t *input, float *output, size_t count)
+{
+	std::memcpy(output, input, count * sizeof(float));
+}
+
+COMPACT_KERNEL void compact::dequantize_fp16(const uint8_t *input, float *output, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		_Float16 value;
+		std::memcpy(&value, input + i * sizeof(value), sizeof(value));
+		output[i] = value;
+	}
+}
+
+COMPACT_KERNEL void compact::dequantize_int8(const uint8_t *input, float scale, float *output, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		output[i] = static_cast<int8_t>(input[i]) * scale;
+	}
+}
@@ -0,0 +1,82 @@
+// Primitives of the compact network encoding
+
+#ifndef H_Compact
+#define H_Compact
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+enum class Quantization
+{
+	NONE, // 32-bit floats
+	FP16, // 16-bit floats
+	INT8, // 8-bit integers, scaled per block and field
+};
+
+constexpr const int maxQuantization = 3;
+
+constexpr std::array<const char *, maxQuantization> quantizations = {"none", "fp16", "int8"};
+
+namespace compact
+{
+	// bytes per value of each quantization
+	constexpr std::array<size_t, maxQuantization> valueSize = {4, 2, 1};
+
+	inline uint64_t zigzag(int64_t value)
+	{
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	inline int64_t unzigzag(uint64_t value)
+	{
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	inline void put_varint(std::vector<uint8_t> &output, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			output.push_back(static_cast<uint8_t>(value) | 0x80);
+			value >>= 7;
+		}
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	// Decodes one varint, advancing position
+	inline uint64_t get_varint(const uint8_t *data, size_t size, size_t &position)
+	{
+		uint64_t value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			if (position >= size)
+			{
+				throw std::runtime_error("Invalid file (truncated varint)");
+			}
+			const uint8_t byte = data[position++];
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return value;
+			}
+		}
+		throw std::runtime_error("Invalid file (varint too long)");
+	}
+
+	/*
+		Decodes count varints into values, returning the number of bytes read.
+		This is a scalar decoder with a fast path: runs of 16 single-byte varints, which most deltas and counts are,
+		are detected with one mask test and widened in a loop the compiler vectorizes. Longer varints are decoded one at a time.
+	*/
+	size_t get_varints(const uint8_t *data, size_t size, uint64_t *values, size_t count);
+
+	// Convert count stored values to floats
+	void dequantize_float(const uint8_t *input, float *output, size_t count);
+	void dequantize_fp16(const uint8_t *input, float *output, size_t count);
+	void dequantize_int8(const uint8_t *input, float scale, float *output, size_t count);
+}
+
+#endif
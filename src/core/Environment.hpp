@@ -1,8 +1,222 @@
 #ifndef H_Environment
 #define H_Environment
 
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "NeuralNetwork.hpp"
+#include "ThreadPool.hpp"
+#include "Random.hpp"
+
+/*
+A population of networks trained by evolution.
+Each generation keeps the fittest networks and replaces the rest with mutated copies of them.
+Every new network is mutated with its own random stream, drawn from the calling thread's generator,
+so training is repeatable after Random::seed no matter how the work is split between threads.
+*/
 class Environment
 {
+public:
+	// higher is better
+	using Fitness = std::function<float(NeuralNetwork &)>;
+
+	struct Individual
+	{
+		std::unique_ptr<NeuralNetwork> network;
+		float fitness = unevaluated;
+	};
+
+	static constexpr float unevaluated = -std::numeric_limits<float>::infinity();
+
+	std::vector<Individual> population;
+	size_t generation = 0;
+
+	Fitness fitness;
+
+	// fraction of the population kept each generation
+	float survivors = 0.1;
+
+	// mutations applied to each new network
+	unsigned mutations = 1;
+
+	BaseElement::MutationOptions mutationOptions{1};
+
+	std::shared_ptr<ThreadPool> pool;
+
+	/*
+		Negated mean squared error of a network's outputs over a data set.
+		The rows are run as one batch against the network's plan.
+	*/
+	static Fitness dataset(NeuralNetwork::Batch inputs, NeuralNetwork::Batch expected, unsigned max_depth = 1000, Propagation propagation = Propagation::FRONTIER)
+	{
+		return [=](NeuralNetwork &network)
+		{
+			Plan &plan = network.plan();
+			plan.propagation = propagation;
+			const NeuralNetwork::Batch outputs = plan.runBatch(inputs, max_depth);
+
+			double error = 0;
+			size_t count = 0;
+			for (size_t row = 0; row < outputs.size(); row++)
+			{
+				for (size_t i = 0; i < outputs[row].size() && i < expected[row].size(); i++)
+				{
+					const double difference = outputs[row][i] - expected[row][i];
+					error += difference * difference;
+					count++;
+				}
+			}
+			return static_cast<float>(count == 0 ? 0 : -error / count);
+		};
+	}
+
+protected:
+	void _mutate(NeuralNetwork &network) const
+	{
+		network.mutationOptions = mutationOptions;
+		for (unsigned i = 0; i < mutations; i++)
+		{
+			try
+			{
+				network.mutate();
+			}
+			catch (const std::exception &)
+			{
+				// a mutation that can not be applied (e.g. removing a missing connection) is skipped
+			}
+		}
+	}
+
+	void _evaluate(Individual &individual) const
+	{
+		const float value = fitness(*individual.network);
+		individual.fitness = std::isnan(value) ? unevaluated : value;
+	}
+
+	void _parallel(size_t count, const ThreadPool::Task &task)
+	{
+		if (pool)
+		{
+			pool->parallel_for(count, task);
+			return;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			task(i, 0);
+		}
+	}
+
+	void _rank()
+	{
+		std::stable_sort(population.begin(), population.end(), [](const Individual &a, const Individual &b)
+						 { return a.fitness > b.fitness; });
+	}
+
+public:
+	// Fills the population with mutated copies of a network, keeping one unchanged copy
+	void seed(const NeuralNetwork &network, size_t size)
+	{
+		population.clear();
+		population.resize(size);
+		generation = 0;
+		const uint64_t seed = Random::local()();
+		_parallel(size, [&](size_t i, [[maybe_unused]] unsigned worker)
+				  {
+			population[i].network = std::make_unique<NeuralNetwork>(network);
+			if (i != 0)
+			{
+				Random::Scope random(seed, i);
+				_mutate(*population[i].network);
+			}
+			_evaluate(population[i]); });
+		_rank();
+	}
+
+	// Evaluates every network that has not been evaluated yet
+	void evaluate()
+	{
+		_parallel(population.size(), [&](size_t i, [[maybe_unused]] unsigned worker)
+				  {
+			if (population[i].fitness == unevaluated)
+			{
+				_evaluate(population[i]);
+			} });
+		_rank();
+	}
+
+	/*
+		Runs one generation.
+		Each replacement is copied, mutated and evaluated as one task, so on a pool the mutation of some networks overlaps the evaluation of others
+		and only selection waits for the whole population.
+	*/
+	void step()
+	{
+		if (population.empty())
+		{
+			throw std::runtime_error("Environment has no population");
+		}
+
+		const size_t kept = std::clamp<size_t>(survivors * population.size(), 1, population.size());
+		const uint64_t seed = Random::local()();
+		_parallel(population.size() - kept, [&](size_t i, [[maybe_unused]] unsigned worker)
+				  {
+			Individual &child = population[kept + i];
+
+			// assigned rather than copied, so the replaced network's plan can take the copy of the parent's
+			if (child.network)
+			{
+				*child.network = *population[i % kept].network;
+			}
+			else
+			{
+				child.network = std::make_unique<NeuralNetwork>(*population[i % kept].network);
+			}
+			Random::Scope random(seed, i);
+			_mutate(*child.network);
+			_evaluate(child); });
+		_rank();
+		generation++;
+	}
+
+	void evolve(size_t generations, const std::function<void(const Environment &)> &onGeneration = nullptr)
+	{
+		for (size_t i = 0; i < generations; i++)
+		{
+			step();
+			if (onGeneration)
+			{
+				onGeneration(*this);
+			}
+		}
+	}
+
+	const Individual &best() const
+	{
+		if (population.empty())
+		{
+			throw std::runtime_error("Environment has no population");
+		}
+		return *std::max_element(population.begin(), population.end(), [](const Individual &a, const Individual &b)
+								 { return a.fitness < b.fitness; });
+	}
+
+	float meanFitness() const
+	{
+		double sum = 0;
+		size_t count = 0;
+		for (const Individual &individual : population)
+		{
+			if (individual.fitness != unevaluated)
+			{
+				sum += individual.fitness;
+				count++;
+			}
+		}
+		return count == 0 ? unevaluated : sum / count;
+	}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -9,6 +9,8 @@
 #include <fstream>
 #include "NeuralNetwork.hpp"
 #include "Environment.hpp"
+#include "MappedFile.hpp"
+#include "Compact.hpp"
 
 enum class FileType
 {
@@ -24,6 +26,9 @@ constexpr std::array<const char *, maxFileType> fileTypes = {"none", "network",
 
 class File
 {
+	friend class NetworkReader;
+	friend class NetworkWriter;
+
 public:
 	using Version = unsigned int;
 
@@ -69,6 +74,25 @@ public:
 		Environment *environment;
 	};
 
+	// number of shards a partial file's network is split into when written, 0 for one per hardware thread
+	size_t shards = 0;
+
+	// how parameters of compact networks are stored when written
+	Quantization quantization = Quantization::NONE;
+
+protected:
+	/*
+		A partial file is a manifest of shards, each a network file with the neurons of a range of slots.
+		Shards are written and read concurrently, then stitched into one network (see NetworkStream.hpp).
+	*/
+	void _writeShards(std::ostream &output, const std::string &path) const;
+	void _readShards(std::istream &input, const std::string &path);
+
+	// compact networks are written and read through the stream classes
+	void _writeCompact(const std::string &path) const;
+	void _readCompact(const std::string &path);
+
+public:
 	inline const std::string magic() const { return std::string(header.magic); }
 	inline void magic(const std::string &magic) { strcpy(header.magic, magic.c_str()); }
 
@@ -84,6 +108,60 @@ public:
 
 	~File() {}
 
+	// how networks are stored
+	enum class Encoding
+	{
+		STREAM,	 // one field at a time
+		MAPPED,	 // fixed-layout arrays (see MappedFile)
+		COMPACT, // blocks of varints and quantized values (see NetworkStream.hpp)
+	};
+
+	static constexpr Version StreamVersion = 1;
+	static constexpr Version MappedVersion = 2;
+	static constexpr Version CompactVersion = 3;
+
+	static constexpr Version DefaultVersion = MappedVersion;
+
+	static Encoding encoding(Version version)
+	{
+		switch (version)
+		{
+		case MappedVersion:
+			return Encoding::MAPPED;
+		case CompactVersion:
+			return Encoding::COMPACT;
+		default:
+			return Encoding::STREAM;
+		}
+	}
+
+	Encoding encoding() const
+	{
+		return encoding(version());
+	}
+
+	// whether the file's network can be mapped rather than read
+	bool mapped() const
+	{
+		return type() == FileType::NETWORK && encoding() == Encoding::MAPPED;
+	}
+
+	// Reads only the header, e.g. to decide whether to map the file
+	void readHeader(const std::string &path)
+	{
+		std::ifstream input(path, std::ios::binary);
+		if (!input.is_open())
+		{
+			throw std::runtime_error("Failed to open file: " + path);
+		}
+
+		read(input, header);
+		if (!input || magic() != Magic)
+		{
+			throw std::runtime_error("Invalid file (bad magic)");
+		}
+	}
+
 	void writePath(const std::string &path) const
 	{
 		std::ofstream output(path, std::ios::binary);
@@ -98,11 +176,23 @@ public:
 		case FileType::NONE:
 			break;
 		case FileType::PARTIAL:
+			_writeShards(output, path);
 			break;
 		case FileType::FULL:
 			write(output, *environment);
 			break;
 		case FileType::NETWORK:
+			if (mapped())
+			{
+				MappedFile::write(output, *network, sizeof(header));
+				break;
+			}
+			if (encoding() == Encoding::COMPACT)
+			{
+				output.close();
+				_writeCompact(path);
+				return;
+			}
 			write(output, *network);
 			break;
 		}
@@ -123,11 +213,23 @@ public:
 		case FileType::NONE:
 			break;
 		case FileType::PARTIAL:
+			_readShards(input, path);
 			break;
 		case FileType::FULL:
+			environment = new Environment();
 			read(input, *environment);
 			break;
 		case FileType::NETWORK:
+			if (mapped())
+			{
+				MappedFile(path, sizeof(header)).read(*network);
+				break;
+			}
+			if (encoding() == Encoding::COMPACT)
+			{
+				_readCompact(path);
+				break;
+			}
 			read(input, *network);
 			break;
 		}
@@ -143,35 +245,32 @@ public:
 };
 
 template <>
-void File::_write(std::ostream &output, const std::string &string)
+inline void File::_write(std::ostream &output, const std::string &string)
 {
 	_write(output, string.size());
 	output.write(string.data(), string.size());
 }
 
 template <>
-void File::_write(std::ostream &output, const Neuron::Connection &conn)
-{
-	_write(output, static_cast<Neuron::ConnectionData>(conn));
-}
-
-template <>
-void File::_write(std::ostream &output, const NeuralNetwork &net)
+inline void File::_write(std::ostream &output, const NeuralNetwork &net)
 {
 	write(output, net.id, net.name, net.activation, net.size());
 
 	for (const auto &[id, neuron] : net)
 	{
-		write(output, id, static_cast<uint8_t>(neuron.type), neuron.outputs.size());
-		for (const Neuron::Connection &conn : neuron.outputs)
+		write(output, id, static_cast<uint8_t>(neuron.type), net.liveOutputs(neuron));
+		for (const Neuron::ConnectionData conn : neuron.outputs)
 		{
-			write(output, conn);
+			if (!net.dangling(conn))
+			{
+				write(output, conn);
+			}
 		}
 	}
 }
 
 template <>
-void File::_read(std::istream &input, std::string &string)
+inline void File::_read(std::istream &input, std::string &string)
 {
 	size_t size;
 	_read(input, size);
@@ -180,13 +279,7 @@ void File::_read(std::istream &input, std::string &string)
 }
 
 template <>
-void File::_read(std::istream &input, Neuron::Connection &conn)
-{
-	_read<Neuron::ConnectionData>(input, conn);
-}
-
-template <>
-void File::_read(std::istream &input, NeuralNetwork &net)
+inline void File::_read(std::istream &input, NeuralNetwork &net)
 {
 	size_t netSize;
 	read(input, net.id, net.name, net.activation, netSize);
@@ -197,9 +290,10 @@ void File::_read(std::istream &input, NeuralNetwork &net)
 		uint8_t type;
 		read(input, neuron._id, type, outputsSize);
 		neuron.type = static_cast<NeuronType>(type);
+		neuron.outputs.reserve(outputsSize);
 		for (size_t o = 0; o < outputsSize; o++)
 		{
-			Neuron::Connection conn;
+			Neuron::ConnectionData conn;
 			read(input, conn);
 			neuron.outputs.push_back(conn);
 		}
@@ -208,4 +302,31 @@ void File::_read(std::istream &input, NeuralNetwork &net)
 	}
 }
 
+template <>
+inline void File::_write(std::ostream &output, const Environment &environment)
+{
+	write(output, environment.generation, environment.population.size());
+	for (const Environment::Individual &individual : environment.population)
+	{
+		write(output, individual.fitness, *individual.network);
+	}
+}
+
+template <>
+inline void File::_read(std::istream &input, Environment &environment)
+{
+	size_t populationSize;
+	read(input, environment.generation, populationSize);
+	environment.population.clear();
+	environment.population.resize(populationSize);
+	for (Environment::Individual &individual : environment.population)
+	{
+		individual.network = std::make_unique<NeuralNetwork>();
+		read(input, individual.fitness, *individual.network);
+	}
+}
+
+// defines the members of File that use the stream classes
+#include "NetworkStream.hpp"
+
 #endif
\ No newline at end of file
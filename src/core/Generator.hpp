@@ -0,0 +1,195 @@
+#ifndef H_Generator
+#define H_Generator
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <numeric>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "Random.hpp"
+#include "ThreadPool.hpp"
+#include "NeuralNetwork.hpp"
+
+// how the targets of generated connections are picked
+enum class Topology
+{
+	RANDOM,		 // any neuron
+	CLUMPED,	 // neurons near the source, by slot
+	SMALL_WORLD, // the next neurons by slot, with some rewired to any neuron (Watts-Strogatz)
+	SCALE_FREE,	 // few neurons are the targets of most connections, with a power law of in-degrees
+	LAYERED,	 // feed-forward, from the inputs through layers of transitional neurons to the outputs
+};
+
+constexpr const int maxTopology = 5;
+
+constexpr std::array<const char *, maxTopology> topologies = {"random", "clumped", "small-world", "scale-free", "layered"};
+
+/*
+Creates the neurons and connections of a network in bulk.
+The neurons are created first, in slot order: inputs, then transitional neurons, then outputs.
+Then the outputs of every neuron are generated in parallel, straight into its storage,
+each from a random stream of its own so the network only depends on the seed.
+As with mutations, connections never start at an output or end at an input.
+*/
+class Generator
+{
+public:
+	size_t neurons = 0;
+	size_t inputs = 0;
+	size_t outputs = 0;
+
+	// total number of connections, spread evenly over the neurons they can start at
+	size_t connections = 0;
+
+	Topology topology = Topology::RANDOM;
+
+	// for CLUMPED: 0 spreads targets over the whole network and 1 keeps them next to the source, like Neuron::mutate
+	float clumping = 0.5;
+
+	// for SMALL_WORLD: chance of a connection going to any neuron instead of a neighbor
+	float rewiring = 0.1;
+
+	// for LAYERED: number of layers the transitional neurons are split into
+	unsigned layers = 4;
+
+	uint64_t seed = Random::local()();
+
+	// when set, outputs are generated on the pool's threads
+	std::shared_ptr<ThreadPool> pool;
+
+	// Adds the generated neurons to a network
+	void generate(NeuralNetwork &network) const
+	{
+		if (neurons < inputs + outputs)
+		{
+			throw std::invalid_argument("The number of input and output neurons exceeds the number of total neurons in the network.");
+		}
+		const size_t sources = neurons - outputs, targets = neurons - inputs;
+		if (connections > 0 && (sources == 0 || targets == 0))
+		{
+			throw std::invalid_argument("Connections need neurons that are not inputs and neurons that are not outputs");
+		}
+		if (topology == Topology::LAYERED && layers == 0)
+		{
+			throw std::invalid_argument("Layered networks need at least one layer");
+		}
+
+		network.reserve(network.slots() + neurons);
+		std::vector<Neuron *> created(neurons);
+		std::vector<size_t> ids(neurons);
+		for (size_t i = 0; i < neurons; i++)
+		{
+			created[i] = &network.create(i < inputs ? NeuronType::INPUT : (i >= neurons - outputs ? NeuronType::OUTPUT : NeuronType::TRANSITIONAL));
+			ids[i] = created[i]->id();
+		}
+
+		if (connections == 0)
+		{
+			return;
+		}
+
+		// scale-free targets are ranked, and ranks are spread over the network by a stride coprime with its size
+		size_t stride = 2654435761 % targets;
+		while (std::gcd(stride, targets) != 1)
+		{
+			stride++;
+		}
+
+		auto generateOutputs = [&](size_t i)
+		{
+			const size_t degree = connections / sources + (i < connections % sources);
+			Random random(seed, i);
+			Neuron::Connections &outputs = created[i]->outputs;
+			outputs.reserve(degree);
+			for (size_t c = 0; c < degree; c++)
+			{
+				Neuron::ConnectionData connection;
+				connection.neuron = ids[_target(i, c, random, stride)];
+				outputs.push_back(connection);
+			}
+		};
+
+		const size_t chunkSize = 4096, numChunks = (sources + chunkSize - 1) / chunkSize;
+		auto generateChunk = [&](size_t chunk, [[maybe_unused]] unsigned worker)
+		{
+			for (size_t i = chunk * chunkSize; i < std::min(sources, (chunk + 1) * chunkSize); i++)
+			{
+				generateOutputs(i);
+			}
+		};
+		if (pool && pool->size() > 1)
+		{
+			pool->parallel_for(numChunks, generateChunk);
+		}
+		else
+		{
+			for (size_t chunk = 0; chunk < numChunks; chunk++)
+			{
+				generateChunk(chunk, 0);
+			}
+		}
+
+		// the outputs were changed in place
+		network.invalidate();
+	}
+
+protected:
+	// Picks the target of the c-th connection of neuron i, both as indices of the generated neurons
+	size_t _target(size_t i, size_t c, Random &random, size_t stride) const
+	{
+		const size_t targets = neurons - inputs;
+		// position of the source among the targets, with inputs spread over them
+		const size_t position = i >= inputs ? i - inputs : i * targets / inputs;
+
+		switch (topology)
+		{
+		case Topology::RANDOM:
+			break;
+		case Topology::CLUMPED:
+		{
+			const int64_t spread = std::max<int64_t>(1, static_cast<int64_t>((1 - clumping) / 2 * targets));
+			// targets wrap around, so neurons at either end are not the targets of more connections
+			const int64_t offset = random.uniform<int64_t>(-spread, spread) % static_cast<int64_t>(targets);
+			return inputs + (static_cast<int64_t>(position) + offset + static_cast<int64_t>(targets)) % targets;
+		}
+		case Topology::SMALL_WORLD:
+			if (random.chance(rewiring))
+			{
+				break;
+			}
+			return inputs + (position + 1 + c) % targets;
+		case Topology::SCALE_FREE:
+		{
+			// the rank of the target has a probability proportional to 1 / (rank + 1), so in-degrees follow a power law
+			const size_t rank = std::min<size_t>(std::exp(random.uniform<double>() * std::log(targets + 1.0)) - 1, targets - 1);
+			return inputs + static_cast<size_t>(static_cast<unsigned __int128>(rank) * stride % targets);
+		}
+		case Topology::LAYERED:
+		{
+			const size_t transitional = neurons - inputs - outputs;
+			if (transitional == 0)
+			{
+				break;
+			}
+			const size_t numLayers = std::min<size_t>(layers, transitional);
+			// inputs are layer 0 and outputs are layer numLayers + 1
+			const size_t layer = i < inputs ? 0 : 1 + (i - inputs) * numLayers / transitional;
+			auto layerBegin = [&](size_t l)
+			{
+				return l == 0 ? 0 : inputs + ((l - 1) * transitional + numLayers - 1) / numLayers;
+			};
+			const size_t begin = layerBegin(layer + 1), end = layer + 1 > numLayers ? neurons : layerBegin(layer + 2);
+			if (begin >= end)
+			{
+				break;
+			}
+			return begin + random.below(end - begin);
+		}
+		}
+		return inputs + random.below(targets);
+	}
+};
+
+#endif
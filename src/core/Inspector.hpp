@@ -4,9 +4,13 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <istream>
+#include <ostream>
 #include <numeric>
 #include <cmath>
 #include <memory>
+#include <optional>
 #include "utils.hpp"
 #include "File.hpp"
 
@@ -140,6 +144,9 @@ public:
 		std::string description;
 		std::function<std::string(Inspector *)> exec;
 
+		// whether the command changes the file, so a script writes the file for a later write command if the command succeeded
+		bool modifies;
+
 		static bool compare_id_size(const Command &a, const Command &b)
 		{
 			return a.id.size() < b.id.size();
@@ -147,6 +154,13 @@ public:
 	};
 
 private:
+	// Marks the running command as failed, for commands that report errors as their result
+	std::string fail(std::string message)
+	{
+		_failed = true;
+		return message;
+	}
+
 	std::string cmd_scope_change()
 	{
 
@@ -269,15 +283,15 @@ private:
 				   "\nneurons: " + std::to_string(network->size());
 		}
 
-		size_t neuron_id = scope.at("neuron");
-		if (!network->has(neuron_id))
+		const NeuronHandle neuron_handle = scope_neuron();
+		if (!neuron_handle.valid())
 		{
 			if (scope_changed)
 				scope.restore(scope_copy);
 			return "Neuron does not exist";
 		}
 
-		Neuron &neuron = network->get(neuron_id);
+		Neuron &neuron = *neuron_handle;
 		if (scope.active == "neuron")
 		{
 			if (scope_changed)
@@ -296,7 +310,7 @@ private:
 					scope.restore(scope_copy);
 				return "Connection does not exist";
 			}
-			Neuron::Connection &conn = neuron.outputs[conn_id];
+			const Neuron::ConnectionData conn = neuron.outputs[conn_id];
 			if (scope_changed)
 				scope.restore(scope_copy);
 			return "Inspecting connection #" + std::to_string(conn_id) + ":" +
@@ -330,17 +344,18 @@ private:
 			mutationCount = 1;
 		}
 
-		BaseElement *target;
+		BaseElement *target = nullptr;
+		std::optional<Neuron::Connection> connection;
 
 		if (scope.active == "top")
 		{
 			switch (type())
 			{
 			case FileType::NONE:
-				return "Nothing to mutate";
+				return fail("Nothing to mutate");
 			case FileType::PARTIAL:
 			case FileType::FULL:
-				return "Environment mutation not supported";
+				return fail("Environment mutation not supported");
 			case FileType::NETWORK:
 				target = static_cast<BaseElement *>(network);
 			}
@@ -349,13 +364,16 @@ private:
 		if (scope.active == "network")
 			target = static_cast<BaseElement *>(network);
 		if (scope.active == "neuron")
-			target = static_cast<BaseElement *>(&network->get(scope.at("neuron")));
+			target = static_cast<BaseElement *>(&*scope_neuron());
 		if (scope.active == "connection")
-			target = static_cast<BaseElement *>(&network->get(scope.at("neuron")).outputs.at(scope.at("connection")));
+		{
+			connection.emplace(scope_neuron()->connection(scope.at("connection")));
+			target = static_cast<BaseElement *>(&*connection);
+		}
 
 		if (target == nullptr)
 		{
-			return "Invalid target";
+			return fail("Invalid target");
 		}
 		for (unsigned i = 0; i < mutationCount; i++)
 			target->mutate(network->mutationOptions);
@@ -377,18 +395,18 @@ private:
 			switch (type())
 			{
 			case FileType::NONE:
-				return "Nothing to create";
+				return fail("Nothing to create");
 			case FileType::PARTIAL:
 			case FileType::FULL:
-				return "Environment creation not supported";
+				return fail("Environment creation not supported");
 			case FileType::NETWORK:
-				return "Network creation not supported";
+				return fail("Network creation not supported");
 			}
 		}
 
 		if (network == nullptr)
 		{
-			return "No active network";
+			return fail("No active network");
 		}
 		if (scope.active == "network")
 		{
@@ -396,16 +414,17 @@ private:
 
 			return "Created neuron #" + std::to_string(n.id());
 		}
-		if (!network->has(scope.at("neuron")))
+		const NeuronHandle neuron_handle = scope_neuron();
+		if (!neuron_handle.valid())
 		{
-			return "No active neuron";
+			return fail("No active neuron");
 		}
-		Neuron &n = network->get(scope.at("neuron"));
+		Neuron &n = *neuron_handle;
 		if (scope.active == "neuron")
 		{
 			if (cmdv.size() < 2)
 			{
-				return "No output neuron specified";
+				return fail("No output neuron specified");
 			}
 			size_t output;
 			try
@@ -414,11 +433,11 @@ private:
 			}
 			catch (const std::exception &ex)
 			{
-				return "Invalid output";
+				return fail("Invalid output");
 			}
 			if (!network->has(output))
 			{
-				return "Specified output neuron does not exist";
+				return fail("Specified output neuron does not exist");
 			}
 			n.connect(network->get(output));
 
@@ -427,52 +446,56 @@ private:
 
 		if (scope.active == "connection")
 		{
-			return "Nothing to create";
+			return fail("Nothing to create");
 		}
 
-		return "Invalid scope";
+		return fail("Invalid scope");
 	}
 
 	std::string cmd_data()
 	{
 		if (cmdv.size() < (cmdv[0] == "data:set" ? 3 : 2))
 		{
-			return "Missing arguments";
+			return fail("Missing arguments");
 		}
 
-		Reflectable *target;
+		Reflectable *target = nullptr;
+		std::optional<Neuron::Connection> connection;
 
 		if (scope.active == "top")
 		{
 			switch (type())
 			{
 			case FileType::NONE:
-				return "No data to " + std::string(cmdv[0] == "data:set" ? "modify" : "interact with");
+				return fail("No data to " + std::string(cmdv[0] == "data:set" ? "modify" : "interact with"));
 			case FileType::PARTIAL:
 			case FileType::FULL:
-				return "Environment " + std::string(cmdv[0] == "data:set" ? "modification" : "data interaction") + " not supported";
+				return fail("Environment " + std::string(cmdv[0] == "data:set" ? "modification" : "data interaction") + " not supported");
 			case FileType::NETWORK:
 				target = static_cast<Reflectable *>(network);
 			}
 		}
 
 		if (scope.active == "environment")
-			return "Environment " + std::string(cmdv[0] == "data:set" ? "modification" : "data interaction") + " not supported";
+			return fail("Environment " + std::string(cmdv[0] == "data:set" ? "modification" : "data interaction") + " not supported");
 		if (scope.active == "network")
 			target = static_cast<Reflectable *>(network);
 		if (scope.active == "neuron")
-			target = static_cast<Reflectable *>(&network->get(scope.at("neuron")));
+			target = static_cast<Reflectable *>(&*scope_neuron());
 		if (scope.active == "connection")
-			target = static_cast<Reflectable *>(&network->get(scope.at("neuron")).outputs.at(scope.at("connection")));
+		{
+			connection.emplace(scope_neuron()->connection(scope.at("connection")));
+			target = static_cast<Reflectable *>(&*connection);
+		}
 
 		if (target == nullptr)
 		{
-			return "No active " + scope.active;
+			return fail("No active " + scope.active);
 		}
 
 		if (!target->hasProperty(cmdv[1]))
 		{
-			return "Property \"" + cmdv[1] + "\" does not exist";
+			return fail("Property \"" + cmdv[1] + "\" does not exist");
 		}
 
 		if (cmdv[0] == "data:get")
@@ -486,25 +509,44 @@ private:
 		}
 		catch (const std::exception &ex)
 		{
-			return "Failed to set \"" + cmdv[1] + "\": " + ex.what();
+			return fail("Failed to set \"" + cmdv[1] + "\": " + ex.what());
 		}
 		return "Set \"" + cmdv[1] + "\" to \"" + target->getPropertyString(cmdv[1]) + "\"";
 	}
 
 	static const inline std::vector<Command> commands = {
-		{"quit", {"q", "exit"}, "Quits the inspector", &Inspector::cmd_quit},
-		{"help", {"h"}, "Displays this help message or the description of a command", &Inspector::cmd_help},
-		{"scope:enter", {">"}, "Enter a deeper scope", &Inspector::cmd_scope_change},
-		{"scope:leave", {"<"}, "Leave a deeper scope", &Inspector::cmd_scope_change},
-		{"scope:reset", {}, "Reset scopes", &Inspector::cmd_scope_reset},
-		{"info", {"i"}, "Display info about the current object", &Inspector::cmd_info},
-		{"mutate", {"m"}, "Mutate the current object", &Inspector::cmd_mutate},
-		{"write", {"w"}, "Write changes made to the file to disk", &Inspector::cmd_write},
-		{"create", {"c"}, "Create a new child object of the current object", &Inspector::cmd_create},
-		{"data:set", {"set", "s"}, "Set a value on the current object", &Inspector::cmd_data},
-		{"data:get", {"get", "g", "print", "p"}, "Get a value on the current object", &Inspector::cmd_data},
+		{"quit", {"q", "exit"}, "Quits the inspector", &Inspector::cmd_quit, false},
+		{"help", {"h"}, "Displays this help message or the description of a command", &Inspector::cmd_help, false},
+		{"scope:enter", {">"}, "Enter a deeper scope", &Inspector::cmd_scope_change, false},
+		{"scope:leave", {"<"}, "Leave a deeper scope", &Inspector::cmd_scope_change, false},
+		{"scope:reset", {}, "Reset scopes", &Inspector::cmd_scope_reset, false},
+		{"info", {"i"}, "Display info about the current object", &Inspector::cmd_info, false},
+		{"mutate", {"m"}, "Mutate the current object", &Inspector::cmd_mutate, true},
+		{"write", {"w"}, "Write changes made to the file to disk", &Inspector::cmd_write, false},
+		{"create", {"c"}, "Create a new child object of the current object", &Inspector::cmd_create, true},
+		{"data:set", {"set", "s"}, "Set a value on the current object", &Inspector::cmd_data, true},
+		{"data:get", {"get", "g", "print", "p"}, "Get a value on the current object", &Inspector::cmd_data, false},
 	};
 
+	// commands by id and by alias
+	static const std::unordered_map<std::string, const Command *> &command_table()
+	{
+		static const std::unordered_map<std::string, const Command *> table = []
+		{
+			std::unordered_map<std::string, const Command *> table;
+			for (const Command &cmd : commands)
+			{
+				table.emplace(cmd.id, &cmd);
+				for (const std::string &alias : cmd.aliases)
+				{
+					table.emplace(alias, &cmd);
+				}
+			}
+			return table;
+		}();
+		return table;
+	}
+
 	std::string scope_stringifier(std::string name, size_t value) const
 	{
 		if (name == "network" && type() == FileType::NETWORK && network->id == value)
@@ -525,13 +567,70 @@ private:
 		return Scope::parse_default(name, value);
 	}
 
+	// handle to the neuron of the active scope
+	NeuronHandle scope_neuron() const
+	{
+		return {network, scope.at("neuron")};
+	}
+
 	bool _loaded = false;
+	bool _failed = false;
 	std::string _path = "";
 	std::vector<std::string> cmdv;
 
 public:
 	Scope scope;
 
+	/*
+		Commands parsed ahead of running them.
+		Each line is a command or alias followed by its arguments, separated by spaces.
+		Empty lines and lines starting with # are skipped.
+	*/
+	struct Script
+	{
+		struct Line
+		{
+			const Command *command;
+			std::vector<std::string> argv;
+			size_t number;
+		};
+
+		std::vector<Line> lines;
+
+		// Throws if a line has a command that does not exist, so nothing is run from a script with a typo
+		static Script Parse(std::istream &input)
+		{
+			Script script;
+			std::string raw_line;
+			for (size_t number = 1; std::getline(input, raw_line); number++)
+			{
+				std::vector<std::string> argv = split(raw_line, " ");
+				std::erase_if(argv, [](const std::string &token)
+							  { return token.empty(); });
+				if (argv.empty() || argv[0][0] == '#')
+				{
+					continue;
+				}
+
+				const Command *command = find_command(argv[0]);
+				if (command == nullptr)
+				{
+					throw std::runtime_error("Line " + std::to_string(number) + ": command \"" + argv[0] + "\" does not exist");
+				}
+				argv[0] = command->id;
+				script.lines.push_back({command, std::move(argv), number});
+			}
+			return script;
+		}
+	};
+
+	// The command with an id or alias, or null if there is none
+	static const Command *find_command(const std::string &name)
+	{
+		auto it = command_table().find(name);
+		return it == command_table().end() ? nullptr : it->second;
+	}
+
 	bool loaded() const
 	{
 		return _loaded;
@@ -608,25 +707,116 @@ public:
 		{
 			return "File invalid";
 		}
-		cmdv = command;
-		for (const Command &cmd : commands)
+		cmdv = std::move(command);
+		const Command *cmd = cmdv.empty() ? nullptr : find_command(cmdv[0]);
+		if (cmd == nullptr)
 		{
-			for (const std::string &alias : cmd.aliases)
+			return "Command does not exist";
+		}
+
+		cmdv[0] = cmd->id;
+		return cmd->exec(this);
+	}
+
+	// What running a script did
+	struct Outcome
+	{
+		size_t commands = 0;
+		size_t failures = 0;
+	};
+
+	/*
+		Runs a script, consuming its lines.
+		Results are written to output unless it is null. There is no prompt or scope shown between commands.
+		Commands that fail, by reporting an error or throwing, are written to errors instead as "Line N: <error>", and the script goes on.
+		Write commands without a path are skipped except for the last one before any quit. The file is written there, not at the end of the script,
+		and only if a command before it changed the file without failing, so changes after it are not written. Nothing is written if write is false.
+	*/
+	Outcome run(Script &&script, std::ostream *output = nullptr, bool write = true, std::ostream *errors = nullptr)
+	{
+		if (!_loaded)
+		{
+			throw std::runtime_error("File not loaded");
+		}
+
+		if (magic() != File::Magic)
+		{
+			throw std::runtime_error("File invalid");
+		}
+
+		const auto writes = [](const Script::Line &line)
+		{
+			return line.command->id == "write" && line.argv.size() < 2;
+		};
+
+		// quit ends the script, so writes after it never run
+		size_t last = script.lines.size();
+		for (size_t i = 0; i < script.lines.size() && script.lines[i].command->id != "quit"; i++)
+		{
+			if (writes(script.lines[i]))
+			{
+				last = i;
+			}
+		}
+
+		const auto report = [&](const Script::Line &line, const std::string &error)
+		{
+			if (errors != nullptr)
+			{
+				*errors << "Line " << line.number << ": " << error << '\n';
+			}
+		};
+
+		bool modified = false;
+		Outcome outcome;
+		for (size_t i = 0; i < script.lines.size(); i++)
+		{
+			Script::Line &line = script.lines[i];
+			if (writes(line) && (i != last || !modified || !write))
+			{
+				continue;
+			}
+
+			cmdv = std::move(line.argv);
+			_failed = false;
+			std::string result;
+			try
+			{
+				result = line.command->exec(this);
+			}
+			catch (const std::exception &ex)
+			{
+				fail(ex.what());
+				result = ex.what();
+			}
+			catch (const std::exception *ex)
 			{
-				if (cmdv[0] == alias)
+				fail(ex->what());
+				result = ex->what();
+				delete ex;
+			}
+
+			outcome.commands++;
+			if (_failed)
+			{
+				outcome.failures++;
+				report(line, result);
+			}
+			else
+			{
+				modified |= line.command->modifies;
+				if (output != nullptr)
 				{
-					cmdv[0] = cmd.id;
-					break;
+					*output << result << '\n';
 				}
 			}
 
-			if (cmdv[0] == cmd.id)
+			if (line.command->id == "quit")
 			{
-				return cmd.exec(this);
+				break;
 			}
 		}
-
-		return "Command does not exist";
+		return outcome;
 	}
 };
 
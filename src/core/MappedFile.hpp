@@ -0,0 +1,322 @@
+#ifndef H_MappedFile
+#define H_MappedFile
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <utility>
+#include <ostream>
+#include <cstdint>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "NeuralNetwork.hpp"
+
+/*
+A network stored as fixed-layout arrays, used by version 2 files.
+The network starts with a Layout, followed by its name and activation, then arrays of neuron records and of connections.
+Both arrays are aligned, so a mapped file is used in place: a plan can be compiled from it without parsing,
+and loading a NeuralNetwork copies each neuron's connections in one go.
+*/
+class MappedFile
+{
+public:
+	// alignment of the arrays, relative to the start of the file
+	static constexpr size_t alignment = 64;
+
+	static uint64_t align(uint64_t position)
+	{
+		return (position + alignment - 1) / alignment * alignment;
+	}
+
+	struct Layout
+	{
+		uint64_t id;
+		uint64_t neurons;			// number of neuron records
+		uint64_t connections;		// number of connections
+		uint64_t neuronsOffset;		// position of the neuron records in the file
+		uint64_t connectionsOffset; // position of the connections in the file
+		uint32_t nameSize;
+		uint32_t activationSize;
+	};
+
+	struct Record
+	{
+		uint64_t id;
+		uint64_t begin; // index of the neuron's first connection
+		uint32_t count; // number of connections
+		uint8_t type;
+		uint8_t reserved[3];
+	};
+
+	using Connection = Neuron::ConnectionData;
+
+	static_assert(sizeof(Record) == 24 && sizeof(Connection) == 24, "Mapped records must have a fixed size");
+
+	// a neuron as seen by Plan
+	struct Entry
+	{
+		NeuronType type;
+		float value;
+		std::span<const Connection> outputs;
+	};
+
+	class iterator
+	{
+		const MappedFile *file = nullptr;
+		size_t i = 0;
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::pair<size_t, Entry>;
+		using difference_type = std::ptrdiff_t;
+
+		iterator() = default;
+
+		iterator(const MappedFile *file, size_t index) : file(file), i(index)
+		{
+		}
+
+		value_type operator*() const
+		{
+			const Record &record = file->records[i];
+			return {record.id, {static_cast<NeuronType>(record.type), Neuron::defaultValue, file->connections.subspan(record.begin, record.count)}};
+		}
+
+		iterator &operator++()
+		{
+			i++;
+			return *this;
+		}
+
+		bool operator==(const iterator &other) const
+		{
+			return i == other.i;
+		}
+	};
+
+protected:
+	const char *data = nullptr;
+	size_t length = 0;
+
+	const Layout *layout = nullptr;
+	std::span<const Record> records;
+	std::span<const Connection> connections;
+
+	// whether [offset, offset + count * size) is inside the file
+	bool _contains(uint64_t offset, uint64_t count, uint64_t size) const
+	{
+		return offset <= length && count <= (length - offset) / size;
+	}
+
+public:
+	/*
+		Slots a file of count neurons may use. Removed neurons leave slots unused, so IDs may be sparse,
+		but reading fills every slot up to the highest, and a corrupt ID would otherwise allocate billions of them.
+	*/
+	static constexpr size_t maxSlots(size_t count)
+	{
+		return count * 8 + 1024;
+	}
+
+	// Maps the network starting at offset in a file
+	MappedFile(const std::string &path, size_t offset)
+	{
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1)
+		{
+			throw std::runtime_error("Failed to open file: " + path);
+		}
+
+		struct stat info;
+		if (fstat(fd, &info) == -1)
+		{
+			close(fd);
+			throw std::runtime_error("Failed to read file: " + path);
+		}
+		length = info.st_size;
+
+		if (length > 0)
+		{
+			void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (mapping == MAP_FAILED)
+			{
+				throw std::runtime_error("Failed to map file: " + path);
+			}
+			data = static_cast<const char *>(mapping);
+		}
+		else
+		{
+			close(fd);
+		}
+
+		if (offset % alignof(Layout) != 0 || !_contains(offset, 1, sizeof(Layout)))
+		{
+			unmap();
+			throw std::runtime_error("Invalid file (truncated network)");
+		}
+		layout = reinterpret_cast<const Layout *>(data + offset);
+
+		if (!_contains(offset + sizeof(Layout), static_cast<uint64_t>(layout->nameSize) + layout->activationSize, 1) ||
+			layout->neuronsOffset % alignment != 0 || !_contains(layout->neuronsOffset, layout->neurons, sizeof(Record)) ||
+			layout->connectionsOffset % alignment != 0 || !_contains(layout->connectionsOffset, layout->connections, sizeof(Connection)))
+		{
+			unmap();
+			throw std::runtime_error("Invalid file (truncated network)");
+		}
+		records = {reinterpret_cast<const Record *>(data + layout->neuronsOffset), layout->neurons};
+		connections = {reinterpret_cast<const Connection *>(data + layout->connectionsOffset), layout->connections};
+
+		for (const Record &record : records)
+		{
+			if (record.begin > connections.size() || record.count > connections.size() - record.begin)
+			{
+				unmap();
+				throw std::runtime_error("Invalid file (connections out of range)");
+			}
+			if (NeuralNetwork::Map::index(record.id) >= maxSlots(records.size()))
+			{
+				unmap();
+				throw std::runtime_error("Invalid file (neuron slot out of range)");
+			}
+		}
+	}
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile()
+	{
+		unmap();
+	}
+
+	void unmap()
+	{
+		if (data != nullptr)
+		{
+			munmap(const_cast<char *>(data), length);
+		}
+		data = nullptr;
+		layout = nullptr;
+		records = {};
+		connections = {};
+	}
+
+	size_t id() const
+	{
+		return layout->id;
+	}
+
+	std::string_view name() const
+	{
+		return {reinterpret_cast<const char *>(layout + 1), layout->nameSize};
+	}
+
+	std::string_view activation() const
+	{
+		return {reinterpret_cast<const char *>(layout + 1) + layout->nameSize, layout->activationSize};
+	}
+
+	const Activation &activationFunction() const
+	{
+		const std::string activation(this->activation());
+		if (!NeuralNetwork::activations.contains(activation))
+		{
+			throw std::runtime_error("Invalid activation function: \"" + activation + "\"");
+		}
+		return NeuralNetwork::activations.at(activation);
+	}
+
+	size_t size() const
+	{
+		return records.size();
+	}
+
+	iterator begin() const
+	{
+		return {this, 0};
+	}
+
+	iterator end() const
+	{
+		return {this, records.size()};
+	}
+
+	// Fills a network with the mapped neurons
+	void read(NeuralNetwork &network) const
+	{
+		network.id = id();
+		network.name = name();
+		network.activation = activation();
+		network.reserve(records.size());
+		for (const Record &record : records)
+		{
+			if (!network.emplace_at(record.id, static_cast<NeuronType>(record.type), &network, record.id))
+			{
+				throw std::runtime_error("Neuron with the same ID already exists");
+			}
+			const std::span<const Connection> outputs = connections.subspan(record.begin, record.count);
+			network.get(record.id).outputs.assign(outputs.begin(), outputs.end());
+		}
+		network.invalidate();
+	}
+
+	// Writes a network in the mapped layout, where position is the position of the output in the file
+	static void write(std::ostream &output, const NeuralNetwork &network, uint64_t position)
+	{
+		Layout layout{};
+		layout.id = network.id;
+		layout.neurons = network.size();
+		layout.nameSize = network.name.size();
+		layout.activationSize = network.activation.size();
+		for (const auto &[id, neuron] : network)
+		{
+			const size_t count = network.liveOutputs(neuron);
+			if (count > UINT32_MAX)
+			{
+				throw std::runtime_error("Neuron has too many connections to write");
+			}
+			layout.connections += count;
+		}
+		layout.neuronsOffset = align(position + sizeof(Layout) + layout.nameSize + layout.activationSize);
+		layout.connectionsOffset = align(layout.neuronsOffset + layout.neurons * sizeof(Record));
+
+		const auto pad = [&](uint64_t from, uint64_t to)
+		{
+			for (; from < to; from++)
+			{
+				output.put(0);
+			}
+		};
+
+		output.write(reinterpret_cast<const char *>(&layout), sizeof(layout));
+		output.write(network.name.data(), network.name.size());
+		output.write(network.activation.data(), network.activation.size());
+		pad(position + sizeof(Layout) + layout.nameSize + layout.activationSize, layout.neuronsOffset);
+
+		uint64_t begin = 0;
+		for (const auto &[id, neuron] : network)
+		{
+			Record record{id, begin, static_cast<uint32_t>(network.liveOutputs(neuron)), static_cast<uint8_t>(neuron.type), {}};
+			output.write(reinterpret_cast<const char *>(&record), sizeof(record));
+			begin += record.count;
+		}
+		pad(layout.neuronsOffset + layout.neurons * sizeof(Record), layout.connectionsOffset);
+
+		for (const auto &[id, neuron] : network)
+		{
+			for (const Connection data : neuron.outputs)
+			{
+				if (!network.dangling(data))
+				{
+					output.write(reinterpret_cast<const char *>(&data), sizeof(data));
+				}
+			}
+		}
+	}
+};
+
+#endif
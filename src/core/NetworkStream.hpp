@@ -0,0 +1,981 @@
+#ifndef H_NetworkStream
+#define H_NetworkStream
+
+#include <string>
+#include <vector>
+#include <array>
+#include <span>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <filesystem>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include "NeuralNetwork.hpp"
+#include "MappedFile.hpp"
+#include "Compact.hpp"
+#include "File.hpp"
+
+/*
+Neurons of a network file, read or written a chunk at a time.
+The connections of chunk.neurons[i] are chunk.connections[begin] to chunk.connections[begin + count].
+*/
+struct NetworkChunk
+{
+	std::vector<MappedFile::Record> neurons;
+	std::vector<Neuron::ConnectionData> connections;
+
+	std::span<const Neuron::ConnectionData> outputs(const MappedFile::Record &neuron) const
+	{
+		return std::span(connections).subspan(neuron.begin, neuron.count);
+	}
+
+	void clear()
+	{
+		neurons.clear();
+		connections.clear();
+	}
+};
+
+/*
+A block of neurons in the compact encoding (version 3).
+Each field is stored as its own column, so every column is decoded in one pass:
+- neurons: varints of the zigzag delta of each neuron's slot from the previous neuron's, its generation, type and number of outputs
+- flags: one byte per connection, with a bit for each parameter that is not the default and a bit for a target generation other than 0
+- targets: varints of the zigzag delta of each target's slot from its source's slot, followed by its generation if flagged
+- values: for each parameter, the values that are not the default, quantized
+*/
+class CompactBlock
+{
+public:
+	// neurons per block
+	static constexpr size_t size = 4096;
+
+	static constexpr uint8_t generationFlag = 1 << 4;
+
+protected:
+	using Parameters = std::array<float, 4>;
+
+	static Parameters _parameters(const Neuron::ConnectionData &conn)
+	{
+		return {conn.strength, conn.plasticityRate, conn.plasticityThreshold, conn.reliability};
+	}
+
+	static uint64_t _slot(size_t id)
+	{
+		return SlotMap<Neuron>::index(id);
+	}
+
+	static uint64_t _generation(size_t id)
+	{
+		return SlotMap<Neuron>::generation(id);
+	}
+
+public:
+	static void encode(const NetworkChunk &chunk, Quantization quantization, std::vector<uint8_t> &output)
+	{
+		const Parameters defaults = _parameters(Neuron::ConnectionData{});
+		std::vector<uint8_t> neurons, flags, targets;
+		std::array<std::vector<float>, 4> values;
+		flags.reserve(chunk.connections.size());
+
+		int64_t previous = 0;
+		for (const MappedFile::Record &neuron : chunk.neurons)
+		{
+			const int64_t slot = _slot(neuron.id);
+			compact::put_varint(neurons, compact::zigzag(slot - previous));
+			compact::put_varint(neurons, _generation(neuron.id));
+			compact::put_varint(neurons, neuron.type);
+			compact::put_varint(neurons, neuron.count);
+			previous = slot;
+
+			for (const Neuron::ConnectionData &conn : chunk.outputs(neuron))
+			{
+				const Parameters parameters = _parameters(conn);
+				uint8_t flag = _generation(conn.neuron) != 0 ? generationFlag : 0;
+				for (size_t p = 0; p < parameters.size(); p++)
+				{
+					// compared bitwise, so every value (e.g. -0) survives unquantized
+					if (std::bit_cast<uint32_t>(parameters[p]) != std::bit_cast<uint32_t>(defaults[p]))
+					{
+						flag |= 1 << p;
+						values[p].push_back(parameters[p]);
+					}
+				}
+				flags.push_back(flag);
+
+				compact::put_varint(targets, compact::zigzag(static_cast<int64_t>(_slot(conn.neuron)) - slot));
+				if (flag & generationFlag)
+				{
+					compact::put_varint(targets, _generation(conn.neuron));
+				}
+			}
+		}
+
+		compact::put_varint(output, chunk.connections.size());
+		compact::put_varint(output, neurons.size());
+		compact::put_varint(output, targets.size());
+		for (const std::vector<float> &column : values)
+		{
+			compact::put_varint(output, column.size());
+		}
+
+		Parameters scales{};
+		if (quantization == Quantization::INT8)
+		{
+			for (size_t p = 0; p < values.size(); p++)
+			{
+				for (float value : values[p])
+				{
+					// one inf or NaN would make the scale, and so every value of the block, meaningless
+					if (!std::isfinite(value))
+					{
+						throw std::runtime_error("Can not quantize connection parameters that are not finite to int8");
+					}
+					scales[p] = std::max(scales[p], std::abs(value) / 127);
+				}
+			}
+			output.insert(output.end(), reinterpret_cast<const uint8_t *>(scales.data()), reinterpret_cast<const uint8_t *>(scales.data() + scales.size()));
+		}
+
+		output.insert(output.end(), neurons.begin(), neurons.end());
+		output.insert(output.end(), flags.begin(), flags.end());
+		output.insert(output.end(), targets.begin(), targets.end());
+		for (size_t p = 0; p < values.size(); p++)
+		{
+			for (float value : values[p])
+			{
+				uint8_t bytes[4];
+				switch (quantization)
+				{
+				case Quantization::NONE:
+					std::memcpy(bytes, &value, sizeof(value));
+					break;
+				case Quantization::FP16:
+				{
+					const _Float16 half = value;
+					std::memcpy(bytes, &half, sizeof(half));
+					break;
+				}
+				case Quantization::INT8:
+					bytes[0] = static_cast<int8_t>(scales[p] > 0 ? std::clamp<long>(std::lround(value / scales[p]), -127, 127) : 0);
+					break;
+				}
+				output.insert(output.end(), bytes, bytes + compact::valueSize[static_cast<size_t>(quantization)]);
+			}
+		}
+	}
+
+	// Appends the neurons of a block to a chunk
+	static void decode(const uint8_t *data, size_t size, size_t neuronCount, Quantization quantization, NetworkChunk &chunk)
+	{
+		const auto invalid = []
+		{
+			return std::runtime_error("Invalid file (bad compact block)");
+		};
+
+		size_t position = 0;
+		const size_t connectionCount = compact::get_varint(data, size, position);
+		const size_t neuronBytes = compact::get_varint(data, size, position);
+		const size_t targetBytes = compact::get_varint(data, size, position);
+		std::array<size_t, 4> valueCounts;
+		for (size_t &count : valueCounts)
+		{
+			count = compact::get_varint(data, size, position);
+		}
+
+		Parameters scales{};
+		if (quantization == Quantization::INT8)
+		{
+			if (size - position < sizeof(scales))
+			{
+				throw invalid();
+			}
+			std::memcpy(scales.data(), data + position, sizeof(scales));
+			position += sizeof(scales);
+		}
+
+		// neurons
+		if (neuronBytes > size - position)
+		{
+			throw invalid();
+		}
+		// every varint takes at least a byte, so counts are checked against the bytes holding them before anything is allocated
+		if (neuronCount > neuronBytes / 4)
+		{
+			throw invalid();
+		}
+		std::vector<uint64_t> neurons(neuronCount * 4);
+		if (compact::get_varints(data + position, neuronBytes, neurons.data(), neurons.size()) != neuronBytes)
+		{
+			throw invalid();
+		}
+		position += neuronBytes;
+
+		// flags
+		if (connectionCount > size - position)
+		{
+			throw invalid();
+		}
+		const uint8_t *flags = data + position;
+		position += connectionCount;
+		std::array<size_t, 4> flagged{};
+		size_t generations = 0;
+		for (size_t i = 0; i < connectionCount; i++)
+		{
+			for (size_t p = 0; p < flagged.size(); p++)
+			{
+				flagged[p] += (flags[i] >> p) & 1;
+			}
+			generations += (flags[i] & generationFlag) != 0;
+		}
+		if (flagged != valueCounts)
+		{
+			throw invalid();
+		}
+
+		// targets
+		if (targetBytes > size - position || connectionCount + generations > targetBytes)
+		{
+			throw invalid();
+		}
+		std::vector<uint64_t> targets(connectionCount + generations);
+		if (compact::get_varints(data + position, targetBytes, targets.data(), targets.size()) != targetBytes)
+		{
+			throw invalid();
+		}
+		position += targetBytes;
+
+		// values
+		const size_t valueSize = compact::valueSize[static_cast<size_t>(quantization)];
+		std::array<std::vector<float>, 4> values;
+		for (size_t p = 0; p < values.size(); p++)
+		{
+			if (valueCounts[p] > (size - position) / valueSize)
+			{
+				throw invalid();
+			}
+			values[p].resize(valueCounts[p]);
+			switch (quantization)
+			{
+			case Quantization::NONE:
+				compact::dequantize_float(data + position, values[p].data(), valueCounts[p]);
+				break;
+			case Quantization::FP16:
+				compact::dequantize_fp16(data + position, values[p].data(), valueCounts[p]);
+				break;
+			case Quantization::INT8:
+				compact::dequantize_int8(data + position, scales[p], values[p].data(), valueCounts[p]);
+				break;
+			}
+			position += valueCounts[p] * valueSize;
+		}
+
+		const Parameters defaults = _parameters(Neuron::ConnectionData{});
+		std::array<size_t, 4> nextValue{};
+		size_t nextTarget = 0, connection = 0;
+		int64_t previous = 0;
+		chunk.neurons.reserve(chunk.neurons.size() + neuronCount);
+		chunk.connections.reserve(chunk.connections.size() + connectionCount);
+		for (size_t n = 0; n < neuronCount; n++)
+		{
+			const int64_t slot = previous + compact::unzigzag(neurons[n * 4]);
+			const uint64_t generation = neurons[n * 4 + 1], type = neurons[n * 4 + 2], count = neurons[n * 4 + 3];
+			if (slot < 0 || slot > UINT32_MAX || generation > UINT32_MAX || type > UINT8_MAX || count > connectionCount - connection)
+			{
+				throw invalid();
+			}
+			previous = slot;
+			chunk.neurons.push_back({SlotMap<Neuron>::key(slot, generation), chunk.connections.size(), static_cast<uint32_t>(count), static_cast<uint8_t>(type), {}});
+
+			for (const size_t end = connection + count; connection < end; connection++)
+			{
+				const uint8_t flag = flags[connection];
+				const int64_t target = slot + compact::unzigzag(targets[nextTarget++]);
+				const uint64_t targetGeneration = flag & generationFlag ? targets[nextTarget++] : 0;
+				if (target < 0 || target > UINT32_MAX || targetGeneration > UINT32_MAX)
+				{
+					throw invalid();
+				}
+
+				Parameters parameters;
+				for (size_t p = 0; p < parameters.size(); p++)
+				{
+					parameters[p] = (flag >> p) & 1 ? values[p][nextValue[p]++] : defaults[p];
+				}
+				Neuron::ConnectionData conn;
+				conn.neuron = SlotMap<Neuron>::key(target, targetGeneration);
+				conn.strength = parameters[0];
+				conn.plasticityRate = parameters[1];
+				conn.plasticityThreshold = parameters[2];
+				conn.reliability = parameters[3];
+				chunk.connections.push_back(conn);
+			}
+		}
+		if (connection != connectionCount || position != size)
+		{
+			throw invalid();
+		}
+	}
+};
+
+/*
+Reads the neurons of a network file in chunks, so memory use does not depend on the size of the network.
+Every encoding is read sequentially.
+*/
+class NetworkReader
+{
+protected:
+	std::ifstream input;
+
+	// connections of mapped files, which are stored after all neurons
+	std::ifstream connections;
+
+	// encoded block of compact files
+	std::vector<uint8_t> block;
+
+	// neurons not yet read
+	size_t remaining = 0;
+
+	// size of the file, which bounds any length read from it
+	size_t fileSize = 0;
+
+	// Checks a length read from the file against what is left of it, before anything is allocated for it
+	size_t _bounded(size_t length, std::istream &source)
+	{
+		const std::streamoff position = source.tellg();
+		if (position < 0 || length > fileSize - std::min<size_t>(position, fileSize))
+		{
+			throw std::runtime_error("Invalid file (truncated network)");
+		}
+		return length;
+	}
+
+	uint64_t _read_varint()
+	{
+		uint64_t value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			const int byte = input.get();
+			if (byte == EOF)
+			{
+				throw std::runtime_error("Invalid file (truncated network)");
+			}
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return value;
+			}
+		}
+		throw std::runtime_error("Invalid file (varint too long)");
+	}
+
+	void _read_string(std::string &string)
+	{
+		string.resize(_bounded(_read_varint(), input));
+		input.read(string.data(), string.size());
+	}
+
+	// Reads a string of stream files, which is stored after its size like File::read does, with the size bounded
+	void _read_sized_string(std::string &string)
+	{
+		size_t length = 0;
+		File::read(input, length);
+		string.resize(_bounded(length, input));
+		input.read(string.data(), string.size());
+	}
+
+public:
+	File::Header header;
+	File::Encoding encoding;
+	Quantization quantization = Quantization::NONE;
+	size_t id = 0;
+	std::string name;
+	std::string activation;
+
+	// number of neurons in the network
+	size_t size = 0;
+
+	NetworkReader(const std::string &path) : input(path, std::ios::binary)
+	{
+		if (!input.is_open())
+		{
+			throw std::runtime_error("Failed to open file: " + path);
+		}
+		fileSize = std::filesystem::file_size(path);
+
+		File::read(input, header);
+		if (!input || std::string(header.magic) != File::Magic)
+		{
+			throw std::runtime_error("Invalid file (bad magic)");
+		}
+		if (static_cast<FileType>(header.type) != FileType::NETWORK)
+		{
+			throw std::runtime_error("Not a network");
+		}
+		encoding = File::encoding(header.version);
+
+		switch (encoding)
+		{
+		case File::Encoding::STREAM:
+			File::read(input, id);
+			_read_sized_string(name);
+			_read_sized_string(activation);
+			File::read(input, size);
+			break;
+		case File::Encoding::MAPPED:
+		{
+			MappedFile::Layout layout;
+			File::read(input, layout);
+			name.resize(_bounded(layout.nameSize, input));
+			activation.resize(_bounded(layout.activationSize, input));
+			input.read(name.data(), name.size());
+			input.read(activation.data(), activation.size());
+			id = layout.id;
+			size = layout.neurons;
+
+			input.seekg(layout.neuronsOffset);
+			connections.open(path, std::ios::binary);
+			connections.seekg(layout.connectionsOffset);
+			break;
+		}
+		case File::Encoding::COMPACT:
+		{
+			id = _read_varint();
+			_read_string(name);
+			_read_string(activation);
+			uint8_t _quantization;
+			File::read(input, size, _quantization);
+			if (_quantization >= maxQuantization)
+			{
+				throw std::runtime_error("Invalid file (unknown quantization)");
+			}
+			quantization = static_cast<Quantization>(_quantization);
+			break;
+		}
+		}
+
+		if (!input || (connections.is_open() && !connections))
+		{
+			throw std::runtime_error("Invalid file (truncated network)");
+		}
+		remaining = size;
+	}
+
+	/*
+		Replaces the contents of a chunk with the next neurons of the network,
+		stopping after maxNeurons neurons or once the chunk holds maxConnections connections.
+		Compact files are read a block at a time instead.
+		Returns false once every neuron has been read.
+	*/
+	bool next(NetworkChunk &chunk, size_t maxNeurons = 4096, size_t maxConnections = 1 << 20)
+	{
+		chunk.clear();
+		if (encoding == File::Encoding::COMPACT)
+		{
+			const size_t count = _read_varint();
+			if (count == 0)
+			{
+				if (remaining != 0)
+				{
+					throw std::runtime_error("Invalid file (truncated network)");
+				}
+				return false;
+			}
+			if (count > remaining)
+			{
+				throw std::runtime_error("Invalid file (too many neurons)");
+			}
+
+			block.resize(_bounded(_read_varint(), input));
+			input.read(reinterpret_cast<char *>(block.data()), block.size());
+			if (!input)
+			{
+				throw std::runtime_error("Invalid file (truncated network)");
+			}
+			CompactBlock::decode(block.data(), block.size(), count, quantization, chunk);
+			remaining -= count;
+			return true;
+		}
+
+		while (remaining > 0 && chunk.neurons.size() < maxNeurons && (chunk.neurons.empty() || chunk.connections.size() < maxConnections))
+		{
+			MappedFile::Record record{};
+			size_t count;
+			if (encoding == File::Encoding::MAPPED)
+			{
+				File::read(input, record);
+				count = record.count;
+			}
+			else
+			{
+				File::read(input, record.id, record.type, count);
+			}
+			if (!input)
+			{
+				throw std::runtime_error("Invalid file (truncated network)");
+			}
+			if (count > UINT32_MAX)
+			{
+				throw std::runtime_error("Neuron has too many connections to read");
+			}
+
+			std::istream &source = encoding == File::Encoding::MAPPED ? connections : input;
+			_bounded(count * sizeof(Neuron::ConnectionData), source);
+
+			record.begin = chunk.connections.size();
+			record.count = count;
+			chunk.connections.resize(record.begin + count);
+
+			source.read(reinterpret_cast<char *>(chunk.connections.data() + record.begin), count * sizeof(Neuron::ConnectionData));
+			if (!source)
+			{
+				throw std::runtime_error("Invalid file (truncated network)");
+			}
+
+			chunk.neurons.push_back(record);
+			remaining--;
+		}
+		return !chunk.neurons.empty();
+	}
+};
+
+/*
+Writes a network file a neuron at a time.
+The neuron count is written when the writer is closed. For mapped files, connections are kept in a temporary file
+next to the output until then, since they are stored after all of the neurons. Compact files are written a block at a time.
+*/
+class NetworkWriter
+{
+protected:
+	std::fstream output;
+	std::string path;
+	File::Header header;
+	File::Encoding encoding;
+	Quantization quantization;
+
+	// position of the neuron count, or of the layout for mapped files
+	std::streampos sizePosition;
+
+	std::fstream connections;
+	MappedFile::Layout layout{};
+
+	// neurons of the next compact block
+	NetworkChunk pending;
+	std::vector<uint8_t> block;
+
+	size_t size = 0;
+	bool closed = false;
+
+	std::string _connectionsPath() const
+	{
+		return path + ".connections";
+	}
+
+	void _pad(uint64_t to)
+	{
+		for (uint64_t position = output.tellp(); position < to; position++)
+		{
+			output.put(0);
+		}
+	}
+
+	void _write_varint(uint64_t value)
+	{
+		std::vector<uint8_t> bytes;
+		compact::put_varint(bytes, value);
+		output.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+	}
+
+	void _write_string(const std::string &string)
+	{
+		_write_varint(string.size());
+		output.write(string.data(), string.size());
+	}
+
+	void _flush()
+	{
+		if (pending.neurons.empty())
+		{
+			return;
+		}
+		block.clear();
+		CompactBlock::encode(pending, quantization, block);
+		_write_varint(pending.neurons.size());
+		_write_varint(block.size());
+		output.write(reinterpret_cast<const char *>(block.data()), block.size());
+		pending.clear();
+	}
+
+public:
+	NetworkWriter(const std::string &path, File::Version version, size_t id, const std::string &name, const std::string &activation, Quantization quantization = Quantization::NONE)
+		: output(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc), path(path), encoding(File::encoding(version)), quantization(quantization)
+	{
+		if (!output.is_open())
+		{
+			throw std::runtime_error("Failed to open file: " + path);
+		}
+
+		strcpy(header.magic, File::Magic);
+		header.type = static_cast<uint8_t>(FileType::NETWORK);
+		header.version = version;
+		File::write(output, header);
+
+		switch (encoding)
+		{
+		case File::Encoding::STREAM:
+			File::write(output, id, name, activation);
+			sizePosition = output.tellp();
+			File::write(output, size);
+			break;
+		case File::Encoding::MAPPED:
+			connections.open(_connectionsPath(), std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+			if (!connections.is_open())
+			{
+				throw std::runtime_error("Failed to open file: " + _connectionsPath());
+			}
+
+			layout.id = id;
+			layout.nameSize = name.size();
+			layout.activationSize = activation.size();
+			sizePosition = output.tellp();
+			File::write(output, layout);
+			output.write(name.data(), name.size());
+			output.write(activation.data(), activation.size());
+			layout.neuronsOffset = MappedFile::align(output.tellp());
+			_pad(layout.neuronsOffset);
+			break;
+		case File::Encoding::COMPACT:
+			_write_varint(id);
+			_write_string(name);
+			_write_string(activation);
+			sizePosition = output.tellp();
+			File::write(output, size, static_cast<uint8_t>(quantization));
+			break;
+		}
+	}
+
+	NetworkWriter(const NetworkWriter &) = delete;
+	NetworkWriter &operator=(const NetworkWriter &) = delete;
+
+	~NetworkWriter()
+	{
+		if (!closed)
+		{
+			try
+			{
+				close();
+			}
+			catch (...)
+			{
+			}
+		}
+	}
+
+	void write(size_t id, NeuronType type, std::span<const Neuron::ConnectionData> outputs)
+	{
+		if (closed)
+		{
+			throw std::runtime_error("Writer is closed");
+		}
+		if (encoding != File::Encoding::STREAM && outputs.size() > UINT32_MAX)
+		{
+			throw std::runtime_error("Neuron has too many connections to write");
+		}
+
+		switch (encoding)
+		{
+		case File::Encoding::STREAM:
+			File::write(output, id, static_cast<uint8_t>(type), outputs.size());
+			output.write(reinterpret_cast<const char *>(outputs.data()), outputs.size_bytes());
+			break;
+		case File::Encoding::MAPPED:
+		{
+			const MappedFile::Record record{id, layout.connections, static_cast<uint32_t>(outputs.size()), static_cast<uint8_t>(type), {}};
+			File::write(output, record);
+			connections.write(reinterpret_cast<const char *>(outputs.data()), outputs.size_bytes());
+			layout.connections += outputs.size();
+			break;
+		}
+		case File::Encoding::COMPACT:
+			pending.neurons.push_back({id, pending.connections.size(), static_cast<uint32_t>(outputs.size()), static_cast<uint8_t>(type), {}});
+			pending.connections.insert(pending.connections.end(), outputs.begin(), outputs.end());
+			if (pending.neurons.size() >= CompactBlock::size)
+			{
+				_flush();
+			}
+			break;
+		}
+		size++;
+	}
+
+	void write(const NetworkChunk &chunk)
+	{
+		for (const MappedFile::Record &neuron : chunk.neurons)
+		{
+			write(neuron.id, static_cast<NeuronType>(neuron.type), chunk.outputs(neuron));
+		}
+	}
+
+	// Writes the neuron count (and for mapped files, the connections), then closes the file
+	void close()
+	{
+		if (closed)
+		{
+			return;
+		}
+		closed = true;
+
+		switch (encoding)
+		{
+		case File::Encoding::STREAM:
+			output.seekp(sizePosition);
+			File::write(output, size);
+			break;
+		case File::Encoding::MAPPED:
+		{
+			layout.neurons = size;
+			layout.connectionsOffset = MappedFile::align(output.tellp());
+			_pad(layout.connectionsOffset);
+
+			connections.seekg(0);
+			std::vector<char> buffer(1 << 20);
+			while (connections.read(buffer.data(), buffer.size()) || connections.gcount() > 0)
+			{
+				output.write(buffer.data(), connections.gcount());
+			}
+			connections.close();
+			std::remove(_connectionsPath().c_str());
+
+			output.seekp(sizePosition);
+			File::write(output, layout);
+			break;
+		}
+		case File::Encoding::COMPACT:
+			_flush();
+			_write_varint(0);
+			output.seekp(sizePosition);
+			File::write(output, size);
+			break;
+		}
+
+		output.close();
+		if (output.fail())
+		{
+			throw std::runtime_error("Failed to write file: " + path);
+		}
+	}
+};
+
+// shard of a partial file, as listed in its manifest
+struct Shard
+{
+	size_t begin; // first slot
+	size_t end;	  // slot after the last
+	size_t neurons;
+	std::string path; // relative to the manifest
+};
+
+inline void File::_writeShards(std::ostream &output, const std::string &path) const
+{
+	const NeuralNetwork &net = *network;
+	const size_t count = std::max<size_t>(1, shards > 0 ? shards : std::thread::hardware_concurrency());
+	const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+	std::vector<Shard> manifest(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		manifest[i].begin = net.slots() * i / count;
+		manifest[i].end = net.slots() * (i + 1) / count;
+		manifest[i].path = std::filesystem::path(path).filename().string() + "." + std::to_string(i);
+	}
+
+	// neurons are only read, so the shards can be written from the same network at once
+	ThreadPool pool(std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency())));
+	pool.parallel_for(count, [&](size_t i, [[maybe_unused]] unsigned worker)
+					  {
+		Shard &shard = manifest[i];
+		NetworkWriter writer((directory / shard.path).string(), version(), net.id, net.name, net.activation, quantization);
+		std::vector<Neuron::ConnectionData> outputs;
+		const auto live = [&net](const Neuron::ConnectionData &conn)
+		{
+			return !net.dangling(conn);
+		};
+		for (size_t slot = shard.begin; slot < shard.end; slot++)
+		{
+			if (!net.used(slot))
+			{
+				continue;
+			}
+			const Neuron &neuron = net.at_slot(slot);
+			outputs.clear();
+			std::copy_if(neuron.outputs.begin(), neuron.outputs.end(), std::back_inserter(outputs), live);
+			writer.write(neuron.id(), neuron.type, outputs);
+			shard.neurons++;
+		}
+		writer.close(); });
+
+	write(output, net.id, net.name, net.activation, net.size(), manifest.size());
+	for (const Shard &shard : manifest)
+	{
+		write(output, shard.begin, shard.end, shard.neurons, shard.path);
+	}
+}
+
+inline void File::_readShards(std::istream &input, const std::string &path)
+{
+	NeuralNetwork &net = *network;
+
+	// counts and lengths come from the file, so they are checked against what is left of it before anything is allocated for them
+	const size_t fileSize = std::filesystem::file_size(path);
+	const auto bounded = [&](size_t count, size_t size)
+	{
+		const std::streamoff position = input.tellg();
+		if (!input || position < 0 || count > (fileSize - std::min<size_t>(position, fileSize)) / size)
+		{
+			throw std::runtime_error("Invalid file (truncated manifest)");
+		}
+		return count;
+	};
+	const auto readString = [&](std::string &string)
+	{
+		size_t length = 0;
+		read(input, length);
+		string.resize(bounded(length, 1));
+		input.read(string.data(), string.size());
+	};
+
+	size_t size = 0, count = 0;
+	read(input, net.id);
+	readString(net.name);
+	readString(net.activation);
+	read(input, size, count);
+
+	// each shard is listed as its first and last slots, neuron count and path length, then the path
+	std::vector<Shard> manifest(bounded(count, 4 * sizeof(size_t)));
+	size_t slots = 0, neurons = 0;
+	for (Shard &shard : manifest)
+	{
+		read(input, shard.begin, shard.end, shard.neurons);
+		readString(shard.path);
+		slots = std::max(slots, shard.end);
+		neurons += shard.neurons;
+
+		// shards are written next to the manifest, so a path that could lead anywhere else is not read
+		const std::filesystem::path shardPath(shard.path);
+		if (shard.path.empty() || shardPath.has_root_path() || shard.path.find_first_of("/\\") != std::string::npos || shard.path.find("..") != std::string::npos)
+		{
+			throw std::runtime_error("Invalid file (bad shard path)");
+		}
+	}
+	if (!input || neurons != size || slots > MappedFile::maxSlots(size))
+	{
+		throw std::runtime_error("Invalid file (bad manifest)");
+	}
+
+	// each shard is read and its connections are copied into place on its own thread, leaving only the neurons to insert in order
+	struct Loaded
+	{
+		std::vector<MappedFile::Record> neurons;
+		std::vector<Neuron::Connections> outputs;
+	};
+	std::vector<Loaded> loaded(count);
+	const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+	ThreadPool pool(std::min<size_t>(std::max<size_t>(count, 1), std::max(1u, std::thread::hardware_concurrency())));
+	pool.parallel_for(count, [&](size_t i, [[maybe_unused]] unsigned worker)
+					  {
+		const Shard &shard = manifest[i];
+		const std::string shardPath = (directory / shard.path).string();
+		NetworkReader reader(shardPath);
+		if (reader.size != shard.neurons)
+		{
+			throw std::runtime_error("Invalid shard: " + shard.path);
+		}
+
+		// every neuron takes at least a byte of its shard, which bounds the count before the shard is read
+		Loaded &result = loaded[i];
+		const size_t expected = std::min<size_t>(shard.neurons, std::filesystem::file_size(shardPath));
+		result.neurons.reserve(expected);
+		result.outputs.reserve(expected);
+		NetworkChunk chunk;
+		while (reader.next(chunk))
+		{
+			for (const MappedFile::Record &neuron : chunk.neurons)
+			{
+				const size_t slot = NeuralNetwork::Map::index(neuron.id);
+				if (slot < shard.begin || slot >= shard.end)
+				{
+					throw std::runtime_error("Invalid shard: " + shard.path);
+				}
+				const std::span<const Neuron::ConnectionData> outputs = chunk.outputs(neuron);
+				result.neurons.push_back(neuron);
+				result.outputs.emplace_back().assign(outputs.begin(), outputs.end());
+			}
+		} });
+
+	net.reserve(slots);
+	for (Loaded &result : loaded)
+	{
+		for (size_t i = 0; i < result.neurons.size(); i++)
+		{
+			const size_t id = result.neurons[i].id;
+			if (!net.emplace_at(id, static_cast<NeuronType>(result.neurons[i].type), &net, id))
+			{
+				throw std::runtime_error("Neuron with the same ID already exists");
+			}
+			net.get(id).outputs = std::move(result.outputs[i]);
+		}
+	}
+	net.invalidate();
+}
+
+inline void File::_writeCompact(const std::string &path) const
+{
+	const NeuralNetwork &net = *network;
+	NetworkWriter writer(path, version(), net.id, net.name, net.activation, quantization);
+	std::vector<Neuron::ConnectionData> outputs;
+	const auto live = [&net](const Neuron::ConnectionData &conn)
+	{
+		return !net.dangling(conn);
+	};
+	for (const auto &[id, neuron] : net)
+	{
+		outputs.clear();
+		std::copy_if(neuron.outputs.begin(), neuron.outputs.end(), std::back_inserter(outputs), live);
+		writer.write(id, neuron.type, outputs);
+	}
+	writer.close();
+}
+
+inline void File::_readCompact(const std::string &path)
+{
+	NeuralNetwork &net = *network;
+	NetworkReader reader(path);
+	net.id = reader.id;
+	net.name = reader.name;
+	net.activation = reader.activation;
+	net.reserve(reader.size);
+
+	NetworkChunk chunk;
+	while (reader.next(chunk))
+	{
+		for (const MappedFile::Record &neuron : chunk.neurons)
+		{
+			if (!net.emplace_at(neuron.id, static_cast<NeuronType>(neuron.type), &net, neuron.id))
+			{
+				throw std::runtime_error("Neuron with the same ID already exists");
+			}
+			const std::span<const Neuron::ConnectionData> outputs = chunk.outputs(neuron);
+			net.get(neuron.id).outputs.assign(outputs.begin(), outputs.end());
+		}
+	}
+	net.invalidate();
+}
+
+#endif
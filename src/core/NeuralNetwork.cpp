@@ -3,6 +3,9 @@
 #include <stdexcept>
 #include <limits>
 #include <algorithm>
+#include <utility>
+#include <iterator>
+#include <chrono>
 #include "utils.hpp"
 #include "NeuralNetwork.hpp"
 
@@ -11,13 +14,18 @@ Neuron::Neuron(NeuronType neuronType, NeuralNetwork *network, size_t id)
 {
 }
 
-size_t Neuron::id() const
+bool NeuronHandle::valid() const
+{
+	return network != nullptr && network->has(*this);
+}
+
+Neuron &NeuronHandle::get() const
 {
 	if (network == nullptr)
 	{
-		throw new std::runtime_error("Invalid network");
+		throw std::runtime_error("Invalid network");
 	}
-	return network->idOf(this);
+	return network->get(*this);
 }
 
 void Neuron::update(unsigned depth)
@@ -36,12 +44,24 @@ void Neuron::update(unsigned depth)
 		return;
 	}
 
-	float activation = network->activationFunction()(value);
+	float activation = network->_activation(value);
 	float outputEffect;
 
-	for (Neuron::Connection &output : outputs)
+	for (size_t i = 0; i < outputs.size(); i++)
 	{
-		Neuron &neuron = network->get(output.neuron);
+		const Connections::Hot &output = outputs.hot[i];
+		const size_t id = NeuralNetwork::Map::key(output.neuron, outputs.cold[i].generation);
+		// connections to removed neurons are dropped lazily (see NeuralNetwork::remove)
+		if (network->expired(id))
+		{
+			continue;
+		}
+		// the slot may hold no neuron, or one the connection's generation is not yet
+		if (!network->has(id))
+		{
+			throw std::out_of_range("Invalid neuron ID");
+		}
+		Neuron &neuron = network->at_slot(output.neuron);
 		if (neuron.type == NeuronType::INPUT)
 		{
 			return;
@@ -60,19 +80,21 @@ void Neuron::mutate(BaseElement::MutationOptions options)
 	{
 		throw new std::runtime_error("Invalid network");
 	}
-	size_t baseID = id(),
-		   net_size = network->size(),
+	// targets are picked by slot, so clumping follows the layout of the network's storage
+	size_t baseIndex = NeuralNetwork::Map::index(id()),
+		   net_size = network->slots(),
 		   max = static_cast<size_t>(options.clumping / 2 * net_size);
-	signed int adjustment = std::floor((0.5 - (baseID / (net_size - 1))) * options.clumping);
-	size_t targetID = baseID + adjustment + (rand_seeded<float>() > 0.5f ? 1 : -1) * (rand_seeded<unsigned>() % max);
-	targetID = std::clamp(targetID, 0ul, net_size - 1);
-	Neuron &neuron = network->get(targetID);
+	signed int adjustment = std::floor((0.5 - (baseIndex / (net_size - 1))) * options.clumping);
+	Random &random = Random::local();
+	const int64_t offset = adjustment + (random.chance() ? 1 : -1) * static_cast<int64_t>(random.below(max));
+	const size_t targetIndex = std::clamp<int64_t>(static_cast<int64_t>(baseIndex) + offset, 0, net_size - 1);
+	Neuron &neuron = network->at_slot(targetIndex);
 	if (type == NeuronType::OUTPUT || neuron.type == NeuronType::INPUT)
 	{
 		return;
 	}
 
-	if (rand_seeded<float>() > 0.5)
+	if (random.chance())
 	{
 		connect(neuron);
 	}
@@ -81,3 +103,1019 @@ void Neuron::mutate(BaseElement::MutationOptions options)
 		unconnect(neuron);
 	}
 }
+
+Neuron::Connection::Connection(Neuron &neuron, size_t index) : _neuron(neuron), _index(index)
+{
+}
+
+template <typename F>
+bool Neuron::Connection::_visit(const std::string &key, F &&f)
+{
+	Connections::Hot &hot = _neuron.outputs.hot.at(_index);
+	Connections::Cold &cold = _neuron.outputs.cold.at(_index);
+	if (key == "neuron")
+	{
+		size_t neuron = NeuralNetwork::Map::key(hot.neuron, cold.generation);
+		f(neuron);
+		hot.neuron = NeuralNetwork::Map::index(neuron);
+		cold.generation = NeuralNetwork::Map::generation(neuron);
+		return true;
+	}
+	if (key == "strength")
+	{
+		f(hot.strength);
+		return true;
+	}
+	if (key == "plasticityRate")
+	{
+		f(cold.plasticityRate);
+		return true;
+	}
+	if (key == "plasticityThreshold")
+	{
+		f(cold.plasticityThreshold);
+		return true;
+	}
+	if (key == "reliability")
+	{
+		f(hot.reliability);
+		return true;
+	}
+	return false;
+}
+
+std::string Neuron::Connection::getPropertyString(const std::string &key)
+{
+	std::string result;
+	if (!_visit(key, [&](const auto &value)
+				{ result = std::to_string(value); }))
+	{
+		throw new std::runtime_error("mapable member does not exist");
+	}
+	return result;
+}
+
+void Neuron::Connection::setProperty(const std::string &key, const std::string &new_value)
+{
+	if (!_visit(key, [&]<typename T>(T &value)
+				{ value = from_string<T>(new_value); }))
+	{
+		throw new std::runtime_error("mapable member does not exist");
+	}
+	_neuron._invalidate();
+}
+
+bool Neuron::Connection::hasProperty(const std::string &key)
+{
+	return key == "neuron" || key == "strength" || key == "plasticityRate" || key == "plasticityThreshold" || key == "reliability";
+}
+
+void Neuron::Connection::mutate([[maybe_unused]] const MutationOptions &options)
+{
+	Connections::Hot &hot = _neuron.outputs.hot.at(_index);
+	Connections::Cold &cold = _neuron.outputs.cold.at(_index);
+	Random &random = Random::local();
+	float newValue = (random.uniform() - .5) * random.uniform() / 2;
+	switch (random.below(5))
+	{
+	case 0:
+		return;
+	case 1:
+		hot.strength += newValue;
+		break;
+	case 2:
+		cold.plasticityRate += newValue;
+		break;
+	case 3:
+		cold.plasticityThreshold += newValue;
+		break;
+	case 4:
+		hot.reliability += newValue;
+		break;
+	}
+	_neuron._invalidate();
+}
+
+void Neuron::_invalidate()
+{
+	if (network != nullptr)
+	{
+		network->invalidate(_id);
+	}
+}
+
+Plan::Plan(NeuralNetwork &network) : activation(network.activationFunction()), source(&network)
+{
+	_compile(std::as_const(network));
+
+	// values held by the network's current plan are taken from it, so this plan can hold them in its place
+	if (network._holds_values())
+	{
+		for (size_t i = 0; i < size(); i++)
+		{
+			values[i] = network.valueOf(std::as_const(network).at(ids[i]));
+		}
+	}
+}
+
+Plan::Plan(const Plan &other, NeuralNetwork &network)
+{
+	assign(other, network);
+}
+
+void Plan::assign(const Plan &other, NeuralNetwork &network)
+{
+	ids = other.ids;
+	types = other.types;
+	values = other.values;
+	ranges = other.ranges;
+	edges = other.edges;
+	inputs = other.inputs;
+	outputs = other.outputs;
+	activation = other.activation;
+	propagation = other.propagation;
+	pool = other.pool;
+	indices = other.indices;
+	_free = other._free;
+	_removed = other._removed;
+	_unresolved = other._unresolved;
+	_unused = other._unused;
+	precision = other.precision;
+	_targets = other._targets;
+	_weights = other._weights;
+	_scales = other._scales;
+	source = &network;
+}
+
+void Plan::patch(const std::vector<size_t> &changed)
+{
+	if (source == nullptr)
+	{
+		throw std::runtime_error("Plan has no network to patch from");
+	}
+	const NeuralNetwork &network = *source;
+
+	// a neuron removed and another added in its slot are patched together, so changes are handled by slot
+	std::vector<size_t> slots;
+	slots.reserve(changed.size());
+	for (size_t id : changed)
+	{
+		slots.push_back(SlotMap<Neuron>::index(id));
+	}
+	std::sort(slots.begin(), slots.end());
+	slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+	// first update the neurons themselves, so targets are known when compiling outputs
+	const auto isIndexed = [](NeuronType type)
+	{
+		return type == NeuronType::INPUT || type == NeuronType::OUTPUT;
+	};
+	bool typesChanged = false;
+	for (size_t slot : slots)
+	{
+		uint32_t index = slot < indices.size() ? indices[slot] : invalid;
+		// edges may still lead to the index of a removed neuron, so a neuron added in its slot gets another index
+		if (index != invalid && (!network.used(slot) || ids[index] != network.at_slot(slot).id()))
+		{
+			typesChanged |= isIndexed(types[index]);
+			_unused += ranges[index].end - ranges[index].begin;
+			ids[index] = removed;
+			types[index] = removedType;
+			ranges[index] = {0, 0};
+			indices[slot] = invalid;
+			_removed.push_back(index);
+			index = invalid;
+		}
+		if (!network.used(slot))
+		{
+			continue;
+		}
+
+		const Neuron &neuron = network.at_slot(slot);
+		if (index == invalid)
+		{
+			if (!_free.empty())
+			{
+				index = _free.back();
+				_free.pop_back();
+			}
+			else
+			{
+				if (size() >= invalid)
+				{
+					throw std::runtime_error("Network is too large to compile");
+				}
+				index = size();
+				ids.push_back(removed);
+				types.push_back(removedType);
+				values.push_back(0);
+				ranges.push_back({0, 0});
+			}
+			if (slot >= indices.size())
+			{
+				indices.resize(slot + 1, invalid);
+			}
+			indices[slot] = index;
+		}
+
+		typesChanged |= types[index] != neuron.type && (isIndexed(types[index]) || isIndexed(neuron.type));
+		ids[index] = neuron.id();
+		types[index] = neuron.type;
+		values[index] = neuron.value;
+	}
+
+	/*
+		Neurons with edges compiled before the neuron they connect to was added are compiled again, so the edges lead to it.
+		The neuron may also have been removed since, in which case compiling drops the edges.
+	*/
+	const size_t patched = slots.size();
+	for (size_t i = 0; i < patched; i++)
+	{
+		const auto it = _unresolved.find(slots[i]);
+		if (it == _unresolved.end())
+		{
+			continue;
+		}
+		for (size_t id : it->second)
+		{
+			if (network.has(id))
+			{
+				slots.push_back(SlotMap<Neuron>::index(id));
+			}
+		}
+		_unresolved.erase(it);
+	}
+	if (slots.size() > patched)
+	{
+		std::sort(slots.begin(), slots.end());
+		slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+	}
+
+	for (size_t slot : slots)
+	{
+		if (!network.used(slot))
+		{
+			continue;
+		}
+		// connections to removed neurons are dropped from the neurons patched (see NeuralNetwork::remove)
+		const auto dangling = [&network](const Neuron::ConnectionData &conn)
+		{
+			return network.dangling(conn);
+		};
+		const Neuron::Connections &connections = network.at_slot(slot).outputs;
+		if (std::any_of(connections.begin(), connections.end(), dangling))
+		{
+			source->at_slot(slot).outputs.erase_if(dangling);
+		}
+
+		const uint32_t index = indices[slot];
+		const size_t begin = edges.size();
+		_unused += ranges[index].end - ranges[index].begin;
+		_compile_outputs(network.at_slot(slot).id(), network.at_slot(slot), network);
+		ranges[index] = {begin, edges.size()};
+		if (precision != Quantization::NONE)
+		{
+			_quantize(index);
+		}
+	}
+
+	if (typesChanged)
+	{
+		_index_types();
+	}
+
+	// compact once most edges are unused or many neurons were removed, dropping the edges to removed neurons so their indices can be reused
+	if (_unused > edges.size() / 2 || _removed.size() > size() / 4)
+	{
+		std::vector<Edge> compacted;
+		compacted.reserve(edges.size() - _unused);
+		for (Range &range : ranges)
+		{
+			const size_t begin = compacted.size();
+			std::copy_if(edges.begin() + range.begin, edges.begin() + range.end, std::back_inserter(compacted), [this](const Edge &edge)
+						 { return edge.target == invalid || types[edge.target] != removedType; });
+			range = {begin, compacted.size()};
+		}
+		edges.swap(compacted);
+		_unused = 0;
+		_free.insert(_free.end(), _removed.begin(), _removed.end());
+		_removed.clear();
+		quantize(precision);
+	}
+}
+
+void Plan::quantize(Quantization _precision)
+{
+	precision = _precision;
+	_targets.clear();
+	_weights.clear();
+	_scales.clear();
+	if (precision == Quantization::NONE)
+	{
+		return;
+	}
+
+	_targets.resize(edges.size());
+	_weights.resize(edges.size() * compact::valueSize[static_cast<size_t>(precision)]);
+	_scales.resize(size());
+	for (uint32_t neuron = 0; neuron < size(); neuron++)
+	{
+		_quantize(neuron);
+	}
+}
+
+void Plan::_quantize(uint32_t neuron)
+{
+	const size_t valueSize = compact::valueSize[static_cast<size_t>(precision)];
+	if (_targets.size() < edges.size())
+	{
+		_targets.resize(edges.size());
+		_weights.resize(edges.size() * valueSize);
+	}
+	if (_scales.size() < size())
+	{
+		_scales.resize(size());
+	}
+
+	const Range &range = ranges[neuron];
+	float maxWeight = 0;
+	for (size_t e = range.begin; e < range.end; e++)
+	{
+		maxWeight = std::max(maxWeight, std::abs(edges[e].strength * edges[e].reliability));
+	}
+	const float scale = std::isfinite(maxWeight) && maxWeight > 0 ? maxWeight / 127 : 1;
+	_scales[neuron] = scale;
+
+	for (size_t e = range.begin; e < range.end; e++)
+	{
+		_targets[e] = edges[e].target;
+		const float weight = edges[e].strength * edges[e].reliability;
+		if (precision == Quantization::FP16)
+		{
+			const _Float16 value = static_cast<_Float16>(weight);
+			std::memcpy(&_weights[e * valueSize], &value, valueSize);
+		}
+		else
+		{
+			_weights[e] = static_cast<uint8_t>(static_cast<int8_t>(std::clamp(std::round(weight / scale), -127.0f, 127.0f)));
+		}
+	}
+}
+
+void Plan::_dequantize(uint32_t neuron, float *weights) const
+{
+	const Range &range = ranges[neuron];
+	const size_t count = range.end - range.begin;
+	if (precision == Quantization::FP16)
+	{
+		compact::dequantize_fp16(_weights.data() + range.begin * sizeof(_Float16), weights, count);
+	}
+	else
+	{
+		compact::dequantize_int8(_weights.data() + range.begin, _scales[neuron], weights, count);
+	}
+}
+
+Plan::Calibration Plan::calibrate(Quantization _precision, const Batch &samples, unsigned max_depth)
+{
+	quantize(Quantization::NONE);
+	const Batch full = runBatch(samples, max_depth);
+	quantize(_precision);
+	const Batch quantized = runBatch(samples, max_depth);
+
+	Calibration calibration;
+	calibration.samples = samples.size();
+	size_t count = 0;
+	for (size_t i = 0; i < full.size(); i++)
+	{
+		for (size_t o = 0; o < full[i].size(); o++, count++)
+		{
+			const float expected = full[i][o], actual = quantized[i][o];
+			// outputs that overflow at both precisions are not an error
+			const double error = expected == actual ? 0 : std::abs(static_cast<double>(expected) - actual);
+			calibration.meanError += error;
+			calibration.maxError = std::max(calibration.maxError, error);
+		}
+	}
+	if (count)
+	{
+		calibration.meanError /= count;
+	}
+	return calibration;
+}
+
+void Plan::_push(std::vector<Frame> &frames, std::vector<float> &frameWeights, const Frame &frame) const
+{
+	frames.push_back(frame);
+	if (precision == Quantization::NONE)
+	{
+		return;
+	}
+	Frame &top = frames.back();
+	top.weights = frameWeights.size();
+	frameWeights.resize(top.weights + ranges[frame.neuron].end - ranges[frame.neuron].begin);
+	_dequantize(frame.neuron, frameWeights.data() + top.weights);
+}
+
+void Plan::_index_types()
+{
+	inputs.clear();
+	outputs.clear();
+	for (uint32_t index : indices)
+	{
+		if (index == invalid)
+		{
+			continue;
+		}
+		if (types[index] == NeuronType::INPUT)
+		{
+			inputs.push_back(index);
+		}
+		if (types[index] == NeuronType::OUTPUT)
+		{
+			outputs.push_back(index);
+		}
+	}
+}
+
+void Plan::load()
+{
+	if (source == nullptr)
+	{
+		return;
+	}
+	for (size_t i = 0; i < size(); i++)
+	{
+		if (ids[i] != removed && !source->_is_stale(SlotMap<Neuron>::index(ids[i])))
+		{
+			values[i] = std::as_const(*source).at(ids[i]).value;
+		}
+	}
+}
+
+void Plan::store() const
+{
+	if (source == nullptr)
+	{
+		return;
+	}
+	for (size_t i = 0; i < size(); i++)
+	{
+		if (ids[i] == removed)
+		{
+			continue;
+		}
+		const size_t slot = SlotMap<Neuron>::index(ids[i]);
+		if (source->owns(slot))
+		{
+			source->at(ids[i]).value = values[i];
+		}
+		else
+		{
+			source->_mark_stale(slot);
+		}
+	}
+}
+
+void Plan::update(unsigned max_depth, Observer *observer)
+{
+	switch (propagation)
+	{
+	case Propagation::RECURSIVE:
+		_update_recursive(max_depth, observer);
+		break;
+	case Propagation::FRONTIER:
+		_update_frontier(max_depth, observer);
+		break;
+	}
+}
+
+void Plan::_update_recursive(unsigned max_depth, Observer *observer)
+{
+	auto enter = [&](uint32_t neuron, unsigned depth)
+	{
+		if (depth == 0 || depth > max_depth)
+		{
+			if (_stats)
+			{
+				_stats->cutoffs++;
+			}
+			return;
+		}
+		if (types[neuron] == NeuronType::OUTPUT)
+		{
+			if (_stats)
+			{
+				_stats->notifications++;
+			}
+			if (observer)
+			{
+				_notify(observer);
+			}
+			return;
+		}
+		_push({neuron, depth, ranges[neuron].begin, activation(values[neuron])});
+		if (_stats)
+		{
+			_count(neuron, stack.size());
+		}
+	};
+
+	stack.reserve(std::min<size_t>(max_depth, size()) + 1);
+	for (uint32_t input : inputs)
+	{
+		enter(input, max_depth);
+		while (!stack.empty())
+		{
+			Frame &frame = stack.back();
+			if (frame.edge == ranges[frame.neuron].end)
+			{
+				stackWeights.resize(frame.weights);
+				stack.pop_back();
+				continue;
+			}
+
+			const size_t e = frame.edge++;
+			const uint32_t target = _target(e);
+			if (target == invalid)
+			{
+				stack.clear();
+				stackWeights.clear();
+				throw std::out_of_range("Invalid neuron ID");
+			}
+			if (types[target] == removedType)
+			{
+				continue;
+			}
+			values[target] *= _effect(frame, e);
+			enter(target, --frame.depth);
+		}
+	}
+}
+
+void Plan::_update_frontier(unsigned max_depth, Observer *observer)
+{
+	const bool parallel = pool && pool->size() > 1;
+
+	frontier.assign(inputs.begin(), inputs.end());
+	next.clear();
+	effects.assign(size(), 1);
+	reached.assign(size(), false);
+	if (parallel)
+	{
+		if (firstChunk.size() != size())
+		{
+			firstChunk = std::vector<std::atomic<uint32_t>>(size());
+		}
+		for (std::atomic<uint32_t> &first : firstChunk)
+		{
+			first.store(UINT32_MAX, std::memory_order_relaxed);
+		}
+	}
+
+	for (unsigned depth = max_depth; depth > 0 && !frontier.empty(); depth--)
+	{
+		// counted here rather than in the steps, so parallel steps need not share counters
+		if (_stats)
+		{
+			for (uint32_t neuron : frontier)
+			{
+				if (types[neuron] != NeuronType::OUTPUT)
+				{
+					_count(neuron, max_depth - depth + 1);
+				}
+			}
+		}
+
+		const bool notify = parallel && frontier.size() > chunkSize ? _step_frontier_parallel() : _step_frontier();
+
+		if (notify && _stats)
+		{
+			_stats->notifications++;
+		}
+		if (notify && observer)
+		{
+			_notify(observer);
+		}
+
+		auto apply = [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const uint32_t neuron = next[i];
+				values[neuron] *= effects[neuron];
+				effects[neuron] = 1;
+				reached[neuron] = false;
+				if (parallel)
+				{
+					firstChunk[neuron].store(UINT32_MAX, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		if (parallel && next.size() > chunkSize)
+		{
+			pool->parallel_for((next.size() + chunkSize - 1) / chunkSize, [&](size_t chunk, [[maybe_unused]] unsigned worker)
+								{ apply(chunk * chunkSize, std::min(next.size(), (chunk + 1) * chunkSize)); });
+		}
+		else
+		{
+			apply(0, next.size());
+		}
+
+		frontier.swap(next);
+		next.clear();
+	}
+
+	if (_stats)
+	{
+		_stats->cutoffs += frontier.size();
+	}
+}
+
+bool Plan::_step_frontier()
+{
+	bool notify = false;
+	for (uint32_t neuron : frontier)
+	{
+		if (types[neuron] == NeuronType::OUTPUT)
+		{
+			notify = true;
+			continue;
+		}
+
+		const float neuronActivation = activation(values[neuron]);
+		_each_output(neuron, weights, [&](uint32_t target, float strength, float reliability)
+					 {
+			if (target == invalid)
+			{
+				throw std::out_of_range("Invalid neuron ID");
+			}
+			if (types[target] == removedType)
+			{
+				return;
+			}
+			if (!reached[target])
+			{
+				reached[target] = true;
+				next.push_back(target);
+			}
+			effects[target] *= neuronActivation * strength * reliability; });
+	}
+	return notify;
+}
+
+bool Plan::_step_frontier_parallel()
+{
+	const size_t numChunks = (frontier.size() + chunkSize - 1) / chunkSize;
+	const size_t numBuckets = pool->size() * 4;
+	if (chunks.size() < numChunks)
+	{
+		chunks.resize(numChunks);
+	}
+
+	auto bucketOf = [&](uint32_t neuron)
+	{
+		return static_cast<size_t>(neuron) * numBuckets / size();
+	};
+
+	pool->parallel_for(numChunks, [&](size_t c, [[maybe_unused]] unsigned worker)
+					   {
+		Chunk &chunk = chunks[c];
+		chunk.contributions.clear();
+		chunk.notify = false;
+
+		const size_t end = std::min(frontier.size(), (c + 1) * chunkSize);
+		for (size_t i = c * chunkSize; i < end; i++)
+		{
+			const uint32_t neuron = frontier[i];
+			if (types[neuron] == NeuronType::OUTPUT)
+			{
+				chunk.notify = true;
+				continue;
+			}
+
+			const float neuronActivation = activation(values[neuron]);
+			_each_output(neuron, chunk.weights, [&](uint32_t target, float strength, float reliability)
+						 {
+				if (target == invalid)
+				{
+					throw std::out_of_range("Invalid neuron ID");
+				}
+				if (types[target] == removedType)
+				{
+					return;
+				}
+				chunk.contributions.push_back({target, neuronActivation * strength * reliability});
+
+				uint32_t first = firstChunk[target].load(std::memory_order_relaxed);
+				while (c < first && !firstChunk[target].compare_exchange_weak(first, c, std::memory_order_relaxed))
+				{
+				} });
+		}
+
+		// group by bucket with a stable counting sort
+		chunk.buckets.assign(numBuckets + 1, 0);
+		for (const Contribution &contribution : chunk.contributions)
+		{
+			chunk.buckets[bucketOf(contribution.target) + 1]++;
+		}
+		for (size_t b = 0; b < numBuckets; b++)
+		{
+			chunk.buckets[b + 1] += chunk.buckets[b];
+		}
+		chunk.sorted.resize(chunk.contributions.size());
+		std::vector<size_t> position(chunk.buckets.begin(), chunk.buckets.end() - 1);
+		for (const Contribution &contribution : chunk.contributions)
+		{
+			chunk.sorted[position[bucketOf(contribution.target)]++] = contribution;
+		} });
+
+	// a neuron joins the next frontier from the chunk that reached it first, at its first contribution in that chunk
+	pool->parallel_for(numChunks, [&](size_t c, [[maybe_unused]] unsigned worker)
+					   {
+		Chunk &chunk = chunks[c];
+		chunk.reached.clear();
+		for (const Contribution &contribution : chunk.contributions)
+		{
+			if (firstChunk[contribution.target].load(std::memory_order_relaxed) == c && !reached[contribution.target])
+			{
+				reached[contribution.target] = true;
+				chunk.reached.push_back(contribution.target);
+			}
+		} });
+
+	pool->parallel_for(numBuckets, [&](size_t b, [[maybe_unused]] unsigned worker)
+					   {
+		for (size_t c = 0; c < numChunks; c++)
+		{
+			const Chunk &chunk = chunks[c];
+			for (size_t i = chunk.buckets[b]; i < chunk.buckets[b + 1]; i++)
+			{
+				effects[chunk.sorted[i].target] *= chunk.sorted[i].effect;
+			}
+		} });
+
+	bool notify = false;
+	for (size_t c = 0; c < numChunks; c++)
+	{
+		notify |= chunks[c].notify;
+		next.insert(next.end(), chunks[c].reached.begin(), chunks[c].reached.end());
+	}
+	return notify;
+}
+
+Plan::Values Plan::run(const Values &inputValues, unsigned max_depth, Observer *observer, Stats *stats)
+{
+	if (inputValues.size() != inputs.size())
+	{
+		throw new std::invalid_argument("Input size does not match the number of input neurons.");
+	}
+
+	using clock = std::chrono::steady_clock;
+	clock::time_point start;
+	auto lap = [&](double &phase)
+	{
+		const clock::time_point now = clock::now();
+		phase += std::chrono::duration<double>(now - start).count();
+		start = now;
+	};
+	if (stats)
+	{
+		stats->runs++;
+		_updated.assign(size(), false);
+		start = clock::now();
+	}
+
+	load();
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		values[inputs[i]] = inputValues[i];
+	}
+	if (stats)
+	{
+		lap(stats->load);
+	}
+
+	_stats = stats;
+	try
+	{
+		update(max_depth, observer);
+	}
+	catch (...)
+	{
+		_stats = nullptr;
+		throw;
+	}
+	_stats = nullptr;
+
+	if (stats)
+	{
+		lap(stats->update);
+	}
+	store();
+	if (stats)
+	{
+		lap(stats->store);
+	}
+	return output_values();
+}
+
+// Applies a connection to every row of a batch, compiled for each vector width like the activation kernels
+__attribute__((target_clones("avx512f", "avx2", "default"))) static void apply_batch(float *__restrict__ target, const float *__restrict__ activations, float strength, float reliability, size_t width)
+{
+	for (size_t b = 0; b < width; b++)
+	{
+		target[b] *= activations[b] * strength * reliability;
+	}
+}
+
+Plan::Batch Plan::runBatch(const Batch &inputValues, unsigned max_depth, size_t width)
+{
+	for (const Values &row : inputValues)
+	{
+		if (row.size() != inputs.size())
+		{
+			throw new std::invalid_argument("Input size does not match the number of input neurons.");
+		}
+	}
+	if (width == 0)
+	{
+		throw std::invalid_argument("Batch width must be positive");
+	}
+
+	load();
+	Batch results(inputValues.size());
+	const size_t groups = (inputValues.size() + width - 1) / width;
+	auto runGroup = [&](size_t group, unsigned worker)
+	{
+		const size_t start = group * width;
+		_run_batch(batchWorkers[worker], inputValues, results, start, std::min(width, inputValues.size() - start), max_depth);
+	};
+
+	if (pool && pool->size() > 1 && groups > 1)
+	{
+		batchWorkers.resize(std::max<size_t>(batchWorkers.size(), pool->size()));
+		pool->parallel_for(groups, runGroup);
+	}
+	else
+	{
+		batchWorkers.resize(std::max<size_t>(batchWorkers.size(), 1));
+		for (size_t group = 0; group < groups; group++)
+		{
+			runGroup(group, 0);
+		}
+	}
+	return results;
+}
+
+void Plan::_run_batch(BatchWorker &worker, const Batch &inputValues, Batch &results, size_t start, size_t count, unsigned max_depth) const
+{
+	std::vector<float> &batch = worker.values;
+	batch.resize(size() * count);
+	for (size_t n = 0; n < size(); n++)
+	{
+		std::fill_n(&batch[n * count], count, values[n]);
+	}
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		for (size_t b = 0; b < count; b++)
+		{
+			batch[inputs[i] * count + b] = inputValues[start + b][i];
+		}
+	}
+
+	switch (propagation)
+	{
+	case Propagation::RECURSIVE:
+		_update_batch_recursive(worker, count, max_depth);
+		break;
+	case Propagation::FRONTIER:
+		_update_batch_frontier(worker, count, max_depth);
+		break;
+	}
+
+	for (size_t b = 0; b < count; b++)
+	{
+		Values &result = results[start + b];
+		result.reserve(outputs.size());
+		for (uint32_t output : outputs)
+		{
+			result.push_back(batch[output * count + b]);
+		}
+	}
+}
+
+// The order of updates does not depend on neuron values, so the rows can share one traversal
+void Plan::_update_batch_recursive(BatchWorker &worker, size_t width, unsigned max_depth) const
+{
+	std::vector<float> &batch = worker.values, &batchActivations = worker.activations, &stackWeights = worker.stackWeights;
+	std::vector<Frame> &stack = worker.stack;
+	auto enter = [&](uint32_t neuron, unsigned depth)
+	{
+		if (depth == 0 || depth > max_depth || types[neuron] == NeuronType::OUTPUT)
+		{
+			return;
+		}
+		const size_t level = stack.size();
+		_push(stack, stackWeights, {neuron, depth, ranges[neuron].begin, 0});
+		batchActivations.resize(std::max(batchActivations.size(), (level + 1) * width));
+		std::copy_n(&batch[neuron * width], width, &batchActivations[level * width]);
+		activation.kernel(&batchActivations[level * width], width);
+	};
+
+	for (uint32_t input : inputs)
+	{
+		enter(input, max_depth);
+		while (!stack.empty())
+		{
+			Frame &frame = stack.back();
+			if (frame.edge == ranges[frame.neuron].end)
+			{
+				stackWeights.resize(frame.weights);
+				stack.pop_back();
+				continue;
+			}
+
+			const size_t e = frame.edge++;
+			const uint32_t target = _target(e);
+			if (target == invalid)
+			{
+				stack.clear();
+				stackWeights.clear();
+				throw std::out_of_range("Invalid neuron ID");
+			}
+			if (types[target] == removedType)
+			{
+				continue;
+			}
+			const float *rowActivations = &batchActivations[(stack.size() - 1) * width];
+			if (precision == Quantization::NONE)
+			{
+				apply_batch(&batch[target * width], rowActivations, edges[e].strength, edges[e].reliability, width);
+			}
+			else
+			{
+				apply_batch(&batch[target * width], rowActivations, stackWeights[frame.weights + e - ranges[frame.neuron].begin], 1, width);
+			}
+			enter(target, --frame.depth);
+		}
+	}
+}
+
+void Plan::_update_batch_frontier(BatchWorker &worker, size_t width, unsigned max_depth) const
+{
+	std::vector<float> &batch = worker.values, &batchActivations = worker.activations, &batchEffects = worker.effects;
+	std::vector<uint32_t> &frontier = worker.frontier, &next = worker.next;
+	std::vector<uint8_t> &reached = worker.reached;
+
+	frontier.assign(inputs.begin(), inputs.end());
+	next.clear();
+	reached.assign(size(), false);
+	batchEffects.assign(size() * width, 1);
+	batchActivations.resize(width);
+
+	for (unsigned depth = max_depth; depth > 0 && !frontier.empty(); depth--)
+	{
+		for (uint32_t neuron : frontier)
+		{
+			if (types[neuron] == NeuronType::OUTPUT)
+			{
+				continue;
+			}
+
+			std::copy_n(&batch[neuron * width], width, batchActivations.data());
+			activation.kernel(batchActivations.data(), width);
+			_each_output(neuron, worker.weights, [&](uint32_t target, float strength, float reliability)
+						 {
+				if (target == invalid)
+				{
+					throw std::out_of_range("Invalid neuron ID");
+				}
+				if (types[target] == removedType)
+				{
+					return;
+				}
+				if (!reached[target])
+				{
+					reached[target] = true;
+					next.push_back(target);
+				}
+				apply_batch(&batchEffects[target * width], batchActivations.data(), strength, reliability, width); });
+		}
+
+		for (uint32_t neuron : next)
+		{
+			float *value = &batch[neuron * width], *effect = &batchEffects[neuron * width];
+			for (size_t b = 0; b < width; b++)
+			{
+				value[b] *= effect[b];
+				effect[b] = 1;
+			}
+			reached[neuron] = false;
+		}
+
+		frontier.swap(next);
+		next.clear();
+	}
+}
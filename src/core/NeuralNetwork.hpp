@@ -5,9 +5,19 @@
 #include <functional>
 #include <cstdint>
 #include <map>
+#include <unordered_map>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
+#include <algorithm>
 #include "utils.hpp"
+#include "Random.hpp"
 #include "generic.hpp"
+#include "SlotMap.hpp"
+#include "Activation.hpp"
+#include "ThreadPool.hpp"
+#include "Compact.hpp"
+#include "Observer.hpp"
 
 #define COPY_WARNING "Copy not allowed"
 
@@ -21,11 +31,11 @@ enum class NeuronType
 
 namespace std
 {
-	string to_string(string &val)
+	inline string to_string(string &val)
 	{
 		return val;
 	}
-	string to_string(NeuronType val)
+	inline string to_string(NeuronType val)
 	{
 		return to_string(static_cast<unsigned int>(val));
 	}
@@ -35,7 +45,43 @@ constexpr const int maxNeuronType = 4;
 
 constexpr std::array<const char *, maxNeuronType> neuronTypes = {"none", "transitional", "input", "output"};
 
+enum class Propagation
+{
+	RECURSIVE, // depth-first, the same as Neuron::update
+	FRONTIER,  // breadth-first, one deduplicated frontier per step
+};
+
+constexpr const int maxPropagation = 2;
+
+constexpr std::array<const char *, maxPropagation> propagations = {"recursive", "frontier"};
+
 class NeuralNetwork;
+class Neuron;
+
+/*
+Cheap reference to a neuron by ID.
+Unlike a Neuron reference, it remains valid when the network's storage changes, and can be checked before use.
+*/
+struct NeuronHandle
+{
+	NeuralNetwork *network = nullptr;
+	size_t id = SIZE_MAX;
+
+	bool valid() const;
+	Neuron &get() const;
+
+	Neuron &operator*() const
+	{
+		return get();
+	}
+
+	Neuron *operator->() const
+	{
+		return &get();
+	}
+
+	bool operator==(const NeuronHandle &other) const = default;
+};
 
 class Neuron : public BaseElement
 {
@@ -47,76 +93,227 @@ public:
 		float plasticityRate = 0;	   // how fast the strength changes
 		float plasticityThreshold = 1; // the max strength
 		float reliability = 1;		   // how reliable the passed value is
+
+		bool operator==(const ConnectionData &other) const
+		{
+			return neuron == other.neuron &&
+				   strength == other.strength &&
+				   plasticityRate == other.plasticityRate &&
+				   plasticityThreshold == other.plasticityThreshold &&
+				   reliability == other.reliability;
+		}
 	} __attribute__((packed));
 
-	class Connection : public ConnectionData, public BaseElement
+	/*
+		The outputs of a neuron, split by how often their fields are read.
+		Updating only reads the hot fields, which are packed five to a cache line with the connected neuron's slot.
+		The cold fields hold the rest: the generation of the connected neuron's ID and the plasticity parameters.
+		Connections are read and added as ConnectionData, and reflected through a Connection.
+	*/
+	class Connections
 	{
-
 	public:
-		REFLECT(neuron, strength, plasticityRate, plasticityThreshold, reliability);
+		struct Hot
+		{
+			uint32_t neuron; // slot of the connected neuron
+			float strength;
+			float reliability;
+		};
+
+		struct Cold
+		{
+			uint32_t generation; // of the connected neuron's ID
+			float plasticityRate;
+			float plasticityThreshold;
+		};
+
+		// one of each per connection, in the same order
+		std::vector<Hot> hot;
+		std::vector<Cold> cold;
+
+		class iterator
+		{
+			const Connections *connections;
+			size_t i;
+
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = ConnectionData;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = ConnectionData;
+
+			iterator(const Connections *connections = nullptr, size_t i = 0) : connections(connections), i(i) {}
+
+			ConnectionData operator*() const
+			{
+				return (*connections)[i];
+			}
+
+			iterator &operator++()
+			{
+				i++;
+				return *this;
+			}
+
+			iterator operator++(int)
+			{
+				iterator previous = *this;
+				i++;
+				return previous;
+			}
+
+			bool operator==(const iterator &other) const
+			{
+				return i == other.i;
+			}
+		};
 
-		Connection(
-			size_t _neuron = SIZE_MAX,
-			float _strength = 0.75,
-			float _plasticityRate = 0,
-			float _plasticityThreshold = 1,
-			float _reliability = 1)
+		iterator begin() const
 		{
-			neuron = _neuron;
-			strength = _strength;
-			plasticityRate = _plasticityRate;
-			plasticityThreshold = _plasticityThreshold;
-			reliability = _reliability;
+			return {this, 0};
 		}
 
-		Connection(ConnectionData &data)
+		iterator end() const
 		{
-			neuron = data.neuron;
-			strength = data.strength;
-			plasticityRate = data.plasticityRate;
-			plasticityThreshold = data.plasticityThreshold;
-			reliability = data.reliability;
+			return {this, size()};
 		}
 
-		// Todo: This should be changed to properly account for the different attributes
-		void mutate()
+		size_t size() const
+		{
+			return hot.size();
+		}
+
+		bool empty() const
 		{
-			float newValue = (rand_seeded<float>() - .5) * rand_seeded<float>() / 2;
-			switch (rand_seeded<int>() % 5)
+			return hot.empty();
+		}
+
+		void clear()
+		{
+			hot.clear();
+			cold.clear();
+		}
+
+		void reserve(size_t capacity)
+		{
+			hot.reserve(capacity);
+			cold.reserve(capacity);
+		}
+
+		ConnectionData operator[](size_t i) const
+		{
+			ConnectionData data;
+			data.neuron = SlotMap<Neuron>::key(hot[i].neuron, cold[i].generation);
+			data.strength = hot[i].strength;
+			data.plasticityRate = cold[i].plasticityRate;
+			data.plasticityThreshold = cold[i].plasticityThreshold;
+			data.reliability = hot[i].reliability;
+			return data;
+		}
+
+		ConnectionData at(size_t i) const
+		{
+			if (i >= size())
 			{
-			case 0:
-				return;
-			case 1:
-				strength += newValue;
-				return;
-			case 2:
-				plasticityRate += newValue;
-				return;
-			case 3:
-				plasticityThreshold += newValue;
-				return;
-			case 4:
-				reliability += newValue;
-				return;
+				throw std::out_of_range("Connection does not exist");
 			}
+			return (*this)[i];
 		}
 
-		bool operator==(const Connection &other) const
+		void push_back(const ConnectionData &data)
 		{
-			return neuron == other.neuron &&
-				   strength == other.strength &&
-				   plasticityRate == other.plasticityRate &&
-				   plasticityThreshold == other.plasticityThreshold &&
-				   reliability == other.reliability;
+			hot.push_back({static_cast<uint32_t>(SlotMap<Neuron>::index(data.neuron)), data.strength, data.reliability});
+			cold.push_back({SlotMap<Neuron>::generation(data.neuron), data.plasticityRate, data.plasticityThreshold});
+		}
+
+		template <std::input_iterator It>
+		void assign(It first, It last)
+		{
+			clear();
+			if constexpr (std::forward_iterator<It>)
+			{
+				reserve(std::distance(first, last));
+			}
+			for (; first != last; ++first)
+			{
+				push_back(*first);
+			}
+		}
+
+		// Removes one connection, keeping the others in order
+		void erase(size_t index)
+		{
+			hot.erase(hot.begin() + index);
+			cold.erase(cold.begin() + index);
+		}
+
+		// Removes the connections matching a predicate of their ConnectionData, keeping the others in order
+		template <typename Predicate>
+		size_t erase_if(Predicate predicate)
+		{
+			size_t kept = 0;
+			for (size_t i = 0; i < size(); i++)
+			{
+				if (predicate((*this)[i]))
+				{
+					continue;
+				}
+				hot[kept] = hot[i];
+				cold[kept] = cold[i];
+				kept++;
+			}
+			const size_t erased = size() - kept;
+			hot.resize(kept);
+			cold.resize(kept);
+			return erased;
 		}
 	};
 
+	/*
+		Reflects and mutates one connection of a neuron.
+		Connections are not stored as objects (see Connections), so this is created when one is needed.
+	*/
+	class Connection : public BaseElement
+	{
+	protected:
+		Neuron &_neuron;
+		size_t _index;
+
+		// Calls f with a reference to the property, returning whether it exists
+		template <typename F>
+		bool _visit(const std::string &key, F &&f);
+
+	public:
+		Connection(Neuron &neuron, size_t index);
+
+		ConnectionData data() const
+		{
+			return _neuron.outputs[_index];
+		}
+
+		std::string getPropertyString(const std::string &key) override;
+		void setProperty(const std::string &key, const std::string &new_value) override;
+		bool hasProperty(const std::string &key) override;
+
+		// Todo: This should be changed to properly account for the different attributes
+		void mutate(const MutationOptions &options) override;
+	};
+
 	size_t _id;
 	NeuralNetwork *network;
 	NeuronType type;
-	std::vector<Connection> outputs{};
+	Connections outputs{};
+
+	size_t id() const
+	{
+		return _id;
+	}
 
-	size_t id() const;
+	NeuronHandle handle() const
+	{
+		return {network, _id};
+	}
 
 	REFLECT(type, value)
 
@@ -142,7 +339,6 @@ public:
 
 	void from(const Neuron &other)
 	{
-		outputs.resize(other.outputs.size());
 		_id = other._id;
 		network = other.network;
 		type = other.type;
@@ -150,31 +346,37 @@ public:
 		value = other.value;
 	}
 
-	void addConnection(Connection connection)
+	void addConnection(const ConnectionData &connection)
 	{
 		outputs.push_back(connection);
+		_invalidate();
 	}
 
-	void addConnection(ConnectionData connection)
+	// Removes the first connection equal to the given one. Duplicates of it are kept, so each unconnect undoes one connect
+	void removeConnection(const ConnectionData &connection)
 	{
-		outputs.push_back(Connection(connection));
-	}
-
-	void removeConnection(const Connection &connection)
-	{
-		std::remove(outputs.begin(), outputs.end(), connection);
+		for (size_t i = 0; i < outputs.size(); i++)
+		{
+			if (outputs[i] == connection)
+			{
+				outputs.erase(i);
+				_invalidate();
+				return;
+			}
+		}
 	}
 
-	Connection connect(Neuron &neuron)
+	ConnectionData connect(Neuron &neuron)
 	{
-		Connection connection = {neuron.id()};
+		ConnectionData connection;
+		connection.neuron = neuron.id();
 		addConnection(connection);
 		return connection;
 	}
 
 	void unconnect(Neuron &neuron)
 	{
-		const auto it = std::find_if(outputs.begin(), outputs.end(), [&](Connection &conn)
+		const auto it = std::find_if(outputs.begin(), outputs.end(), [&](const ConnectionData &conn)
 									 { return conn.neuron == neuron.id(); });
 
 		if (it == outputs.end())
@@ -185,74 +387,586 @@ public:
 		removeConnection(*it);
 	}
 
-	float value = 0.5;
+	Connection connection(size_t index)
+	{
+		if (index >= outputs.size())
+		{
+			throw std::out_of_range("Connection does not exist");
+		}
+		return Connection(*this, index);
+	}
+
+	static constexpr float defaultValue = 0.5;
+
+	float value = defaultValue;
 
 	void update(unsigned max_depth = 1000);
 	void mutate(BaseElement::MutationOptions options);
+
+protected:
+	// mark the neuron as changed in the network's compiled plan, if any
+	void _invalidate();
 };
 
-class NeuralNetwork : public std::map<size_t, Neuron>, public BaseElement
+/*
+A network frozen into contiguous arrays.
+Neurons are addressed by their index in the plan rather than their ID, and the outputs of neuron i are edges[ranges[i].begin] to edges[ranges[i].end].
+When compiled, the ranges follow each other in CSR form. Patching a neuron appends its new outputs and leaves the old ones unused,
+until enough are unused that the edges are compacted.
+*/
+class Plan
 {
 public:
-	using Map = std::map<size_t, Neuron>;
-	using Activation = std::function<float(float)>;
 	using Values = std::vector<float>;
-	using NeuronV = std::vector<std::reference_wrapper<Neuron>>;
-	using UpdateCallback = std::function<void(const Values)>;
+	using Batch = std::vector<Values>;
 
-	class activations
+	struct Edge
 	{
-	public:
-		static float relu(float x)
+		uint32_t target; // index of the target neuron
+		float strength;
+		float reliability;
+	};
+
+	struct Range
+	{
+		size_t begin;
+		size_t end;
+	};
+
+	// target of a connection to a neuron that does not exist
+	static constexpr uint32_t invalid = UINT32_MAX;
+
+	// ID of an index whose neuron was removed
+	static constexpr size_t removed = SIZE_MAX;
+
+	/*
+		Type of an index whose neuron was removed. Connections to a removed neuron are left in their neurons (see NeuralNetwork::remove),
+		so edges to its index are skipped until the edges are compacted, and only then is the index reused.
+	*/
+	static constexpr NeuronType removedType = static_cast<NeuronType>(UINT8_MAX);
+
+	std::vector<size_t> ids;
+	std::vector<NeuronType> types;
+	std::vector<float> values;
+	std::vector<Range> ranges;
+	std::vector<Edge> edges;
+	std::vector<uint32_t> inputs;
+	std::vector<uint32_t> outputs;
+	Activation activation;
+	Propagation propagation = Propagation::RECURSIVE;
+
+	// when set, frontier propagation splits large steps across the pool's threads
+	std::shared_ptr<ThreadPool> pool;
+
+	// precision of the connection weights used when running, see quantize
+	Quantization precision = Quantization::NONE;
+
+	// how far the outputs of a quantized plan are from those at full precision
+	struct Calibration
+	{
+		size_t samples = 0;
+		double meanError = 0; // mean absolute difference of an output
+		double maxError = 0;
+	};
+
+	/*
+		What a run cost, collected when run is given stats to add to.
+		An update is a neuron applying its outputs, so a neuron reached again within a run is updated (and revisited) again.
+	*/
+	struct Stats
+	{
+		size_t runs = 0;
+		size_t updates = 0;
+		size_t edges = 0;		  // connections traversed by updates
+		size_t revisits = 0;	  // updates of neurons already updated in the same run
+		size_t notifications = 0; // times outputs were reached, i.e. an observer would be notified
+		size_t cutoffs = 0;		  // neurons reached but not updated because of max_depth
+		unsigned depth = 0;		  // deepest level reached, counting inputs as 1
+
+		// wall time of each phase, in seconds
+		double load = 0;
+		double update = 0;
+		double store = 0;
+	};
+
+	Plan(NeuralNetwork &network);
+
+	// Copies the compiled plan of another network, e.g. one the network was copied from
+	Plan(const Plan &other, NeuralNetwork &network);
+
+	// Same as the copy constructor, reusing the plan's memory
+	void assign(const Plan &other, NeuralNetwork &network);
+
+	/*
+		Compiles a network that is not a NeuralNetwork, e.g. one mapped from a file (see _compile).
+		The plan has no network to load values from or store them to, so it starts from each neuron's stored value.
+	*/
+	template <typename Network>
+	explicit Plan(const Network &network) : activation(network.activationFunction()), source(nullptr)
+	{
+		_compile(network);
+	}
+
+	size_t size() const
+	{
+		return ids.size();
+	}
+
+	Values output_values() const
+	{
+		Values outputValues;
+		outputValues.reserve(outputs.size());
+		for (uint32_t output : outputs)
+		{
+			outputValues.push_back(values[output]);
+		}
+		return outputValues;
+	}
+
+	/*
+		Updates the plan for neurons of its network that were added, removed, or had their type or outputs changed, given by ID.
+		Only those neurons are compiled again, so this costs in proportion to the change rather than to the network.
+	*/
+	void patch(const std::vector<size_t> &changed);
+
+	// copy neuron values from the network, except those the plan holds for it (see store)
+	void load();
+
+	/*
+		Copies neuron values back to the network.
+		A neuron in a page the network shares with its copies keeps its value in the plan instead, so a run does not copy the page.
+		The network marks the page stale and takes the values from the plan when it next changes the page (see NeuralNetwork::valueOf).
+	*/
+	void store() const;
+
+	// Propagates from the inputs, notifying the observer, if any, each time outputs are reached
+	void update(unsigned max_depth = 1000, Observer *observer = nullptr);
+
+	Values run(const Values &inputValues, unsigned max_depth = 1000, Observer *observer = nullptr, Stats *stats = nullptr);
+
+	/*
+		Runs every row of inputs independently, starting from the network's current values and leaving them unchanged.
+		Rows are run width at a time, with each neuron holding one contiguous value per row, so every connection is applied to all of the rows at once.
+		With a pool, groups of width rows are run on its threads.
+	*/
+	Batch runBatch(const Batch &inputValues, unsigned max_depth = 1000, size_t width = 256);
+
+	/*
+		Sets the precision used when running. Each connection's strength and reliability are folded into one weight,
+		stored as fp16 or as int8 scaled by the largest weight of its neuron, so a run reads 6 or 5 bytes per edge instead of 12.
+		The full precision edges are kept, so NONE goes back to them exactly.
+	*/
+	void quantize(Quantization precision);
+
+	// Quantizes the plan, then runs the samples at full and at the new precision to measure the error (see Calibration)
+	Calibration calibrate(Quantization precision, const Batch &samples, unsigned max_depth = 1000);
+
+protected:
+	/*
+		Builds the plan from anything that iterates (id, neuron) pairs in slot order,
+		where neurons have a type, a value and outputs with a target neuron, strength and reliability.
+	*/
+	template <typename Network>
+	void _compile(const Network &network)
+	{
+		if (network.size() >= invalid)
+		{
+			throw std::runtime_error("Network is too large to compile");
+		}
+
+		for (const auto &[id, neuron] : network)
+		{
+			const uint32_t index = ids.size();
+			const size_t slot = SlotMap<Neuron>::index(id);
+			if (slot >= indices.size())
+			{
+				indices.resize(slot + 1, invalid);
+			}
+			indices[slot] = index;
+			ids.push_back(id);
+			types.push_back(neuron.type);
+			values.push_back(neuron.value);
+			if (neuron.type == NeuronType::INPUT)
+			{
+				inputs.push_back(index);
+			}
+			if (neuron.type == NeuronType::OUTPUT)
+			{
+				outputs.push_back(index);
+			}
+		}
+
+		ranges.reserve(size());
+		for (const auto &[id, neuron] : network)
+		{
+			const size_t begin = edges.size();
+			_compile_outputs(id, neuron, network);
+			ranges.push_back({begin, edges.size()});
+		}
+	}
+
+	// Appends the edges of a neuron, leaving out connections to neurons the network has removed
+	template <typename Element, typename Network>
+	void _compile_outputs(size_t id, const Element &neuron, const Network &network)
+	{
+		// output neurons notify instead of propagating
+		if (neuron.type == NeuronType::OUTPUT)
 		{
-			return (x > 0) ? x : 0;
+			return;
 		}
+
+		for (const auto &output : neuron.outputs)
+		{
+			if constexpr (requires { network.expired(output.neuron); })
+			{
+				if (network.expired(output.neuron))
+				{
+					continue;
+				}
+			}
+
+			// a target is only valid if its slot holds the same generation of neuron
+			const size_t slot = SlotMap<Neuron>::index(output.neuron);
+			const uint32_t target = slot < indices.size() && indices[slot] != invalid && ids[indices[slot]] == output.neuron ? indices[slot] : invalid;
+
+			// propagation stops at the first connection to an input
+			if (target != invalid && types[target] == NeuronType::INPUT)
+			{
+				break;
+			}
+
+			// the neuron connected to may be added later (see patch)
+			if (target == invalid)
+			{
+				std::vector<size_t> &sources = _unresolved[slot];
+				if (sources.empty() || sources.back() != id)
+				{
+					sources.push_back(id);
+				}
+			}
+
+			edges.push_back({target, output.strength, output.reliability});
+		}
+	}
+
+	// plan index of each slot of the network
+	std::vector<uint32_t> indices;
+
+	// indices of removed neurons, which edges no longer point to
+	std::vector<uint32_t> _free;
+
+	// indices of removed neurons that edges may still point to, freed when the edges are compacted
+	std::vector<uint32_t> _removed;
+
+	// IDs of the neurons with an edge to each slot that had no neuron of the connection's generation when the edge was compiled
+	std::unordered_map<size_t, std::vector<size_t>> _unresolved;
+
+	// edges no longer in any range
+	size_t _unused = 0;
+
+	// Rebuilds inputs and outputs in slot order, after neurons of either type were patched
+	void _index_types();
+
+	// quantized edges, in the same order as edges: their targets, weights (valueSize bytes each) and the int8 scale of each neuron
+	std::vector<uint32_t> _targets;
+	std::vector<uint8_t> _weights;
+	std::vector<float> _scales;
+
+	// Quantizes the outputs of a neuron
+	void _quantize(uint32_t neuron);
+
+	// Converts the quantized weights of a neuron's outputs to floats
+	void _dequantize(uint32_t neuron, float *weights) const;
+
+	/*
+		Calls f(target, strength, reliability) for each output of a neuron.
+		Quantized weights are dequantized into buffer and passed as the strength, with a reliability of 1.
+	*/
+	template <typename F>
+	void _each_output(uint32_t neuron, std::vector<float> &buffer, F &&f) const
+	{
+		const Range &range = ranges[neuron];
+		if (precision == Quantization::NONE)
+		{
+			for (size_t e = range.begin; e < range.end; e++)
+			{
+				f(edges[e].target, edges[e].strength, edges[e].reliability);
+			}
+			return;
+		}
+
+		buffer.resize(range.end - range.begin);
+		_dequantize(neuron, buffer.data());
+		for (size_t e = range.begin; e < range.end; e++)
+		{
+			f(_targets[e], buffer[e - range.begin], 1.0f);
+		}
+	}
+
+	// dequantized weights of a neuron's outputs
+	std::vector<float> weights;
+
+	friend class NeuralNetwork;
+
+	// the network the plan was compiled from, if any. Neurons are found by ID, since the network may move them when its pages are unshared
+	NeuralNetwork *source;
+
+	struct Frame
+	{
+		uint32_t neuron;
+		unsigned depth;
+		size_t edge;
+		float activation;
+		size_t weights = 0; // where the neuron's dequantized weights start in stackWeights
+	};
+
+	std::vector<Frame> stack;
+	std::vector<float> stackWeights;
+
+	// Pushes a frame, dequantizing its neuron's weights
+	void _push(const Frame &frame)
+	{
+		_push(stack, stackWeights, frame);
+	}
+
+	void _push(std::vector<Frame> &frames, std::vector<float> &frameWeights, const Frame &frame) const;
+
+	// the target of an edge, and its effect from the neuron of a frame
+	uint32_t _target(size_t edge) const
+	{
+		return precision == Quantization::NONE ? edges[edge].target : _targets[edge];
+	}
+
+	float _effect(const Frame &frame, size_t edge) const
+	{
+		if (precision == Quantization::NONE)
+		{
+			return frame.activation * edges[edge].strength * edges[edge].reliability;
+		}
+		return frame.activation * stackWeights[frame.weights + edge - ranges[frame.neuron].begin];
+	}
+
+	// stats of the current run, if collected, and which neurons it has updated
+	Stats *_stats = nullptr;
+	std::vector<uint8_t> _updated;
+
+	// Counts an update of a neuron in _stats
+	void _count(uint32_t neuron, unsigned depth)
+	{
+		_stats->updates++;
+		_stats->edges += ranges[neuron].end - ranges[neuron].begin;
+		_stats->revisits += _updated[neuron];
+		_stats->depth = std::max(_stats->depth, depth);
+		_updated[neuron] = true;
+	}
+
+	// Mirrors the recursion in Neuron::update, using an explicit stack
+	void _update_recursive(unsigned max_depth, Observer *observer);
+
+	// Notifies an observer that the outputs were reached
+	void _notify(Observer *observer) const
+	{
+		observer->notify(outputs.size(), [this](float *outputValues)
+						 {
+			for (size_t i = 0; i < outputs.size(); i++)
+			{
+				outputValues[i] = values[outputs[i]];
+			} });
+	}
+
+	std::vector<uint32_t> frontier;
+	std::vector<uint32_t> next;
+	std::vector<float> effects;
+	std::vector<uint8_t> reached;
+
+	/*
+		Updates the network one step at a time, for at most max_depth steps.
+		Each step updates the neurons reached by the previous one, and a neuron reached through several connections
+		is updated once with the product of their effects, so a run costs at most edges * max_depth.
+	*/
+	void _update_frontier(unsigned max_depth, Observer *observer);
+
+	// collects the effects of the frontier into next and effects, returning whether an output was reached
+	bool _step_frontier();
+
+	// frontier neurons per chunk of a parallel step
+	static constexpr size_t chunkSize = 256;
+
+	struct Contribution
+	{
+		uint32_t target;
+		float effect;
+	};
+
+	struct Chunk
+	{
+		std::vector<Contribution> contributions;
+		std::vector<Contribution> sorted; // contributions grouped by bucket, in their original order within a bucket
+		std::vector<size_t> buckets;	  // contributions to bucket b are sorted[buckets[b]] to sorted[buckets[b + 1]]
+		std::vector<uint32_t> reached;	  // neurons first reached by this chunk
+		std::vector<float> weights;
+		bool notify;
 	};
 
+	std::vector<Chunk> chunks;
+	std::vector<std::atomic<uint32_t>> firstChunk;
+
+	/*
+		Same as _step_frontier, with the frontier split into chunks that are processed in parallel.
+		Contributions are then applied in parallel by ranges of target neurons,
+		walking the chunks in order so every neuron's effects are multiplied in the same order as with one thread.
+	*/
+	bool _step_frontier_parallel();
+
+	// what a thread running rows of a batch works with, so batches only read the plan
+	struct BatchWorker
+	{
+		std::vector<float> values; // neuron values of the rows being run, with the values of neuron i at values[i * width]
+		std::vector<float> activations;
+		std::vector<float> effects;
+		std::vector<Frame> stack;
+		std::vector<float> stackWeights;
+		std::vector<uint32_t> frontier;
+		std::vector<uint32_t> next;
+		std::vector<uint8_t> reached;
+		std::vector<float> weights;
+	};
+
+	std::vector<BatchWorker> batchWorkers;
+
+	// Runs count rows of a batch from start, into results
+	void _run_batch(BatchWorker &worker, const Batch &inputValues, Batch &results, size_t start, size_t count, unsigned max_depth) const;
+
+	void _update_batch_recursive(BatchWorker &worker, size_t width, unsigned max_depth) const;
+	void _update_batch_frontier(BatchWorker &worker, size_t width, unsigned max_depth) const;
+};
+
+class NeuralNetwork : public SlotMap<Neuron>, public BaseElement
+{
+public:
+	using Map = SlotMap<Neuron>;
+	using Values = std::vector<float>;
+	using NeuronV = std::vector<std::reference_wrapper<Neuron>>;
+	using Batch = std::vector<Values>;
+
 protected:
-	// fix neurons' pointers to this network
-	void _update()
+	// fix the pointers of neurons in pages copied from other networks, and take the values the plan holds for them
+	void _adopt(Neuron &neuron) override
+	{
+		neuron.network = this;
+		neuron.value = valueOf(neuron);
+	}
+
+	// whether the plan holds values of any neuron (see Plan::store)
+	bool _holds_values() const
+	{
+		return std::find(_stale.begin(), _stale.end(), true) != _stale.end();
+	}
+
+	// Moves the values the plan holds back into the neurons, before the plan is dropped
+	void _restore_values()
+	{
+		for (size_t page = 0; page < _stale.size(); page++)
+		{
+			if (_stale[page])
+			{
+				_own(page);
+			}
+		}
+	}
+
+	// Replaces the plan with a copy only this network uses, reusing the memory of the spare plan if there is one
+	void _copy_plan()
 	{
-		for (auto &[id, neuron] : *this)
+		if (_spare)
+		{
+			_spare->assign(*_plan, *this);
+			_plan = std::move(_spare);
+		}
+		else
 		{
-			neuron.network = this;
+			_plan = std::make_shared<Plan>(*_plan, *this);
 		}
 	}
 
 	void _notify()
 	{
-		if(!runCallback)
+		if (_observer == nullptr)
 		{
 			return;
 		}
 
-		runCallback(output_values());
+		_observer->notify(_outputs.size(), [this](float *outputValues)
+						  {
+			for (size_t i = 0; i < _outputs.size(); i++)
+			{
+				outputValues[i] = _outputs[i]->value;
+			} });
 	}
 
 	unsigned _max_depth = 1;
 
-	UpdateCallback runCallback;
+	// resolved from activation when the network is updated
+	Activation _activation;
+
+	// observer of the current update, and the output neurons it is notified of, found once per update
+	Observer *_observer = nullptr;
+	std::vector<Neuron *> _outputs;
+
+	// shared with copies of the network until either changes
+	std::shared_ptr<Plan> _plan;
+
+	// IDs of neurons changed since the plan was last compiled or patched
+	std::vector<size_t> _changed;
+
+	// a plan only this network used before it was assigned another's, kept so copying the new plan can reuse its memory
+	std::shared_ptr<Plan> _spare;
 
 	friend class Neuron;
+	friend class Plan;
 
+	// neurons are found through the const view, so only the pages of the neurons returned are unshared
 	NeuronV ofType(NeuronType type)
 	{
-		NeuronV ofType;
-		for (auto &[id, neuron] : *this)
+		std::vector<size_t> ids;
+		for (const auto &[id, neuron] : std::as_const(*this))
 		{
 			if (neuron.type == type)
 			{
-				//neuron.network = this;
-				ofType.push_back(std::ref(neuron));
+				ids.push_back(id);
 			}
 		}
 
+		NeuronV ofType;
+		ofType.reserve(ids.size());
+		for (size_t id : ids)
+		{
+			ofType.push_back(std::ref(get(id)));
+		}
 		return ofType;
 	}
 
+	Values _values_of_type(NeuronType type) const
+	{
+		Values values;
+		for (const auto &[id, neuron] : *this)
+		{
+			if (neuron.type == type)
+			{
+				values.push_back(valueOf(neuron));
+			}
+		}
+		return values;
+	}
+
 public:
 	const static inline std::map<std::string, Activation> activations{
-		{"relu", &activations::relu},
+		{"identity", {activations::identity, activations::identity}},
+		{"relu", {activations::relu, activations::relu}},
+		{"leaky_relu", {activations::leaky_relu, activations::leaky_relu}},
+		{"sigmoid", {activations::sigmoid, activations::sigmoid}},
+		{"tanh", {activations::tanh, activations::tanh}},
+		{"softsign", {activations::softsign, activations::softsign}},
 	};
 
 	size_t id;
@@ -272,23 +986,26 @@ public:
 
 	REFLECT(name, activation)
 
-	NeuralNetwork(std::string activation = "relu", std::string name = "", size_t id = 0) : id(id != 0 ? id : reinterpret_cast<std::uintptr_t>(&*this)), name(!name.empty() ? name : "default"), activation(activation)
+	// without an ID, one is drawn from the thread's generator, so seeded runs create the same IDs
+	NeuralNetwork(std::string activation = "relu", std::string name = "", size_t id = 0) : id(id != 0 ? id : Random::local()() | 1), name(!name.empty() ? name : "default"), activation(activation)
 	{
 		if (!activations.contains(activation))
 		{
 			throw std::runtime_error("Invalid activation function: \"" + activation + "\"");
 		}
+		_activation = activationFunction();
 	}
 
-	__attribute__((warning(COPY_WARNING)))
-	NeuralNetwork(const NeuralNetwork &other) : std::map<size_t, Neuron>(other)
+	// Shares the other network's neurons and plan, see from. Copies are cheap, so unlike neurons they are not warned about
+	NeuralNetwork(const NeuralNetwork &other) : Map(other), _activation(other._activation), _plan(other._plan), _changed(other._changed), id(other.id), name(other.name), activation(other.activation)
 	{
-		from(other);
+		if (_holds_values())
+		{
+			_copy_plan();
+		}
 	}
 
-	__attribute__((warning(COPY_WARNING)))
-	NeuralNetwork &
-	operator=(const NeuralNetwork &other)
+	NeuralNetwork &operator=(const NeuralNetwork &other)
 	{
 		if (this == &other)
 		{
@@ -300,19 +1017,106 @@ public:
 		return *this;
 	}
 
-	// deep copy data from another network
+	/*
+		Copy data from another network.
+		The neurons and compiled plan are shared with the other network, and each page of neurons is copied when either network first changes it,
+		so copying costs one pointer per page of neurons and a mutation copies only the pages it touches.
+		If the other network's plan holds values of its neurons (see Plan::store), the plan is copied so they stay with the neurons.
+	*/
 	void from(const NeuralNetwork &other)
 	{
 		id = other.id;
 		name = other.name;
 		activation = other.activation;
-		for (const auto &[id, neuron] : other)
+		_activation = other._activation;
+		Map::operator=(other);
+		if (_plan.use_count() == 1)
+		{
+			_spare = std::move(_plan);
+		}
+		_plan = other._plan;
+		_changed = other._changed;
+		if (_holds_values())
+		{
+			_copy_plan();
+		}
+	}
+
+	/*
+		Freezes the network into a plan, which is used by run.
+		Changes made to connections or neuron types outside of the network's and neurons' methods require calling compile again.
+	*/
+	Plan &compile()
+	{
+		prune();
+		_plan = std::make_shared<Plan>(*this);
+		_changed.clear();
+		return *_plan;
+	}
+
+	/*
+		The network's plan, compiled if there is none.
+		Neurons changed since it was compiled are patched into it (see Plan::patch), and a plan shared with another network is copied first.
+	*/
+	Plan &plan()
+	{
+		if (!_plan)
+		{
+			return compile();
+		}
+		if (_plan.use_count() > 1 && (_plan->source != this || !_changed.empty()))
+		{
+			_copy_plan();
+		}
+		_plan->source = this;
+		if (!_changed.empty())
+		{
+			_plan->patch(_changed);
+			_changed.clear();
+		}
+		return *_plan;
+	}
+
+	bool compiled() const
+	{
+		return _plan != nullptr;
+	}
+
+	// Drops the plan, so it is compiled again from scratch
+	void invalidate()
+	{
+		_restore_values();
+		_plan.reset();
+		_changed.clear();
+	}
+
+	// Marks a neuron as added, removed or changed, to be patched into the plan
+	void invalidate(size_t id)
+	{
+		if (!_plan)
+		{
+			return;
+		}
+
+		// past a point, compiling again is cheaper than patching
+		if (_changed.size() >= size() / 8 + 16)
+		{
+			invalidate();
+			return;
+		}
+		_changed.push_back(id);
+	}
+
+	// The value of a neuron, which the network's plan holds instead if the neuron's page was shared when the plan stored it (see Plan::store)
+	float valueOf(const Neuron &neuron) const
+	{
+		const size_t slot = index(neuron.id());
+		if (!_is_stale(slot) || !_plan)
 		{
-			Neuron copied;
-			copied.from(neuron);
-			copied.network = this;
-			this->insert_or_assign(id, neuron);
+			return neuron.value;
 		}
+		const uint32_t i = slot < _plan->indices.size() ? _plan->indices[slot] : Plan::invalid;
+		return i != Plan::invalid && _plan->ids[i] == neuron.id() ? _plan->values[i] : neuron.value;
 	}
 
 	size_t idOf(const Neuron *neuron) const
@@ -327,32 +1131,33 @@ public:
 		throw std::runtime_error("Neuron not found in network");
 	}
 
-	size_t next_id(size_t id = 0)
+	// the ID a neuron added with the given ID will have
+	size_t next_id(size_t id = 0) const
 	{
-		while (has(id))
-		{
-			id++;
-		}
-		return id;
+		return available(id) ? id : next_key();
 	}
 
 	Neuron &get(size_t id)
 	{
-		_update();
 		return at(id);
 	}
 
+	Neuron &get(const NeuronHandle &handle)
+	{
+		return at(handle.id);
+	}
+
 	size_t add(Neuron &neuron)
 	{
 		size_t id = next_id(neuron._id);
 		neuron._id = id;
+		neuron.network = this;
 
-		if (has(id))
+		if (!insert(id, neuron))
 		{
 			throw std::runtime_error("Neuron with the same ID already exists");
 		}
-		neuron.network = this;
-		insert_or_assign(id, neuron);
+		invalidate(id);
 		return id;
 	}
 
@@ -362,34 +1167,68 @@ public:
 		return get(add(_neuron));
 	}
 
-	bool has(size_t id)
+	bool has(size_t id) const
 	{
 		return contains(id);
 	}
 
+	bool has(const NeuronHandle &handle) const
+	{
+		return handle.network == this && contains(handle.id);
+	}
+
+	/*
+		Removes a neuron, without looking for the connections to it, so removing costs the same however many neurons connect to it.
+		Those connections keep the neuron's ID, which is then expired (see dangling): runs skip them, files leave them out,
+		and they are dropped from their neurons when the plan is next compiled or patches those neurons.
+	*/
 	void remove(size_t id)
 	{
-		auto it = find(id);
-		if (it == end())
+		if (!has(id))
 		{
 			throw std::out_of_range("Invalid neuron ID");
 		}
-		erase(it);
+		erase(id);
+		invalidate(id);
 	}
 
-	NeuronV inputs()
+	// Whether a connection leads to a neuron that has been removed (see remove)
+	bool dangling(const Neuron::ConnectionData &connection) const
 	{
-		return ofType(NeuronType::INPUT);
+		return expired(connection.neuron);
+	}
+
+	// The number of a neuron's connections that do not dangle, which is how many are written to files
+	size_t liveOutputs(const Neuron &neuron) const
+	{
+		return std::count_if(neuron.outputs.begin(), neuron.outputs.end(), [this](const Neuron::ConnectionData &conn)
+							 { return !dangling(conn); });
 	}
 
-	Values input_values()
+	// Drops the connections to removed neurons. Only neurons that have one are changed, so the other pages stay shared
+	void prune()
 	{
-		Values inputValues;
-		for (Neuron &input : inputs())
+		const auto dangling = [this](const Neuron::ConnectionData &conn)
+		{
+			return this->dangling(conn);
+		};
+		for (const auto &[id, neuron] : std::as_const(*this))
 		{
-			inputValues.push_back(input.value);
+			if (std::any_of(neuron.outputs.begin(), neuron.outputs.end(), dangling))
+			{
+				get(id).outputs.erase_if(dangling);
+			}
 		}
-		return inputValues;
+	}
+
+	NeuronV inputs()
+	{
+		return ofType(NeuronType::INPUT);
+	}
+
+	Values input_values() const
+	{
+		return _values_of_type(NeuronType::INPUT);
 	}
 
 	void input_values(Values values)
@@ -407,58 +1246,85 @@ public:
 		return ofType(NeuronType::OUTPUT);
 	}
 
-	Values output_values()
+	Values output_values() const
 	{
-		Values outputValues;
-		for (Neuron &output : outputs())
-		{
-			outputValues.push_back(output.value);
-		}
-		return outputValues;
+		return _values_of_type(NeuronType::OUTPUT);
 	}
 
-	void update(unsigned max_depth = 1000)
+	void update(unsigned max_depth = 1000, Observer *observer = nullptr)
 	{
 		_max_depth = max_depth;
-		for (Neuron &inputNeuron : inputs())
+		_activation = activationFunction();
+		_observer = observer;
+		_outputs.clear();
+		if (observer)
+		{
+			for (Neuron &output : outputs())
+			{
+				_outputs.push_back(&output);
+			}
+		}
+		try
+		{
+			for (Neuron &inputNeuron : inputs())
+			{
+				inputNeuron.update(max_depth);
+			}
+		}
+		catch (...)
 		{
-			inputNeuron.update(max_depth);
+			_observer = nullptr;
+			throw;
 		}
+		_observer = nullptr;
 	}
 
 	void mutate()
 	{
 
-		float random = rand_seeded<float>();
+		Random &random = Random::local();
+		const float choice = random.uniform();
 
-		size_t target = rand_seeded<unsigned>() % size();
-		if (random < .6)
+		size_t target = random.below(slots());
+		if (choice < .6)
 		{
-			get(target).mutate(mutationOptions);
+			at_slot(target).mutate(mutationOptions);
 			return;
 		}
 
-		if (random < 0.75 && has(target))
+		// inputs and outputs are kept, so the network can still be run against the same data
+		if (choice < 0.75 && used(target) && std::as_const(*this).at_slot(target).type == NeuronType::TRANSITIONAL)
 		{
-			remove(target);
+			remove(at_slot(target).id());
 			return;
 		}
 
 		create(NeuronType::TRANSITIONAL);
 	}
 
-	Values run(const Values inputValues, unsigned max_depth = 1000, UpdateCallback onUpdate = nullptr)
+	// Stats are counted by the plan, so collecting them compiles the network if needed (see Plan::Stats)
+	Values run(const Values inputValues, unsigned max_depth = 1000, Observer *observer = nullptr, Plan::Stats *stats = nullptr)
 	{
+		if (_plan || stats)
+		{
+			return plan().run(inputValues, max_depth, observer, stats);
+		}
+
 		if (inputValues.size() != inputs().size())
 		{
 			throw new std::invalid_argument("Input size does not match the number of input neurons.");
 		}
 
-		runCallback = onUpdate;
 		input_values(inputValues);
-		update(max_depth);
+		update(max_depth, observer);
 		return output_values();
 	}
+
+	// Runs many inputs against the network's plan, compiling it if needed (see Plan::runBatch)
+	Batch runBatch(const Batch &inputValues, unsigned max_depth = 1000)
+	{
+		return plan().runBatch(inputValues, max_depth);
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#ifndef H_Observer
+#define H_Observer
+
+#include <span>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+
+/*
+Watches the outputs of a running network.
+The network notifies the observer every time outputs are reached, and the observer samples some of those notifications:
+every N of them, at most once per interval, and/or only when an output changed, in any combination.
+Only samples read the outputs, into a buffer the observer keeps between samples, so sampling does not allocate once the buffer has grown.
+The callback gets a span over that buffer, which is valid until the next sample.
+*/
+class Observer
+{
+public:
+	using Callback = std::function<void(std::span<const float>)>;
+	using clock = std::chrono::steady_clock;
+
+	Callback callback;
+
+	// sample every N notifications
+	uint64_t every = 1;
+
+	// sample at most once per interval, if not zero
+	clock::duration interval = clock::duration::zero();
+
+	// sample only when an output differs from the last sample
+	bool onChange = false;
+
+	uint64_t notifications = 0;
+	uint64_t samples = 0;
+
+	Observer() = default;
+
+	Observer(Callback callback, uint64_t every = 1) : callback(std::move(callback)), every(every) {}
+
+	// the outputs of the last sample
+	std::span<const float> outputs() const
+	{
+		return _outputs;
+	}
+
+	/*
+		Called by the network each time outputs are reached, with the number of outputs and a function that copies them into a float *.
+		Inlined, so a notification that is not sampled costs a counter and a comparison.
+	*/
+	template <typename Fill>
+	void notify(size_t size, Fill &&fill)
+	{
+		if (++notifications % std::max<uint64_t>(every, 1) != 0)
+		{
+			return;
+		}
+
+		clock::time_point now;
+		if (interval != clock::duration::zero())
+		{
+			now = clock::now();
+			if (samples > 0 && now - _last < interval)
+			{
+				return;
+			}
+		}
+
+		if (onChange)
+		{
+			_scratch.resize(size);
+			fill(_scratch.data());
+			if (samples > 0 && std::equal(_scratch.begin(), _scratch.end(), _outputs.begin(), _outputs.end()))
+			{
+				return;
+			}
+			_outputs.swap(_scratch);
+		}
+		else
+		{
+			_outputs.resize(size);
+			fill(_outputs.data());
+		}
+
+		_last = now;
+		samples++;
+		if (callback)
+		{
+			callback(_outputs);
+		}
+	}
+
+	// Forgets previous notifications and samples, e.g. before observing another run
+	void reset()
+	{
+		notifications = 0;
+		samples = 0;
+		_last = {};
+	}
+
+protected:
+	std::vector<float> _outputs;
+
+	// outputs read to compare with the last sample
+	std::vector<float> _scratch;
+
+	clock::time_point _last;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef H_Random
+#define H_Random
+
+#include <array>
+#include <span>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <random>
+#include <cstdint>
+#include <numbers>
+#include <concepts>
+
+/*
+A xoshiro256** generator (see https://prng.di.unimi.it).
+Each thread has its own generator (see local()), so random numbers can be drawn from many threads without locking.
+Generators are created from a seed and a stream, and every stream of a seed is independent.
+After Random::seed, the generator of each thread is the stream of the order in which the thread first draws a number,
+so code that needs the same numbers regardless of which thread runs it should use a Scope with a stream of its own.
+*/
+class Random
+{
+protected:
+	std::array<uint64_t, 4> state;
+
+	static uint64_t _rotl(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	static uint64_t _splitmix(uint64_t &x)
+	{
+		uint64_t z = (x += 0x9e3779b97f4a7c15);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		return z ^ (z >> 31);
+	}
+
+	static inline std::atomic<uint64_t> _seed{std::random_device{}() | static_cast<uint64_t>(std::random_device{}()) << 32};
+
+	// incremented by seed(), so threads know to reseed their generator
+	static inline std::atomic<uint64_t> _epoch{0};
+
+	static inline std::atomic<uint64_t> _streams{0};
+
+public:
+	using result_type = uint64_t;
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+	Random(uint64_t seed, uint64_t stream = 0)
+	{
+		uint64_t x = seed ^ _rotl(stream * 0xd1342543de82ef95, 32);
+		for (uint64_t &word : state)
+		{
+			word = _splitmix(x);
+		}
+	}
+
+	result_type operator()()
+	{
+		const uint64_t result = _rotl(state[1] * 5, 7) * 9, t = state[1] << 17;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = _rotl(state[3], 45);
+		return result;
+	}
+
+	// Uniform in [0, 1)
+	template <std::floating_point T = float>
+	T uniform()
+	{
+		constexpr int bits = std::numeric_limits<T>::digits;
+		static_assert(bits < 64);
+		return static_cast<T>((*this)() >> (64 - bits)) * (static_cast<T>(1) / static_cast<T>(uint64_t(1) << bits));
+	}
+
+	// Uniform in [min, max)
+	template <std::floating_point T>
+	T uniform(T min, T max)
+	{
+		return min + (max - min) * uniform<T>();
+	}
+
+	// Uniform in [0, bound), or 0 if bound is 0
+	uint64_t below(uint64_t bound)
+	{
+		return static_cast<uint64_t>((static_cast<unsigned __int128>((*this)()) * bound) >> 64);
+	}
+
+	// Uniform in [min, max]
+	template <std::integral T>
+	T uniform(T min, T max)
+	{
+		return min + static_cast<T>(below(static_cast<uint64_t>(max - min) + 1));
+	}
+
+	// True with the given probability
+	bool chance(double probability = 0.5)
+	{
+		return uniform<double>() < probability;
+	}
+
+	template <std::floating_point T = float>
+	T normal(T mean = 0, T stddev = 1)
+	{
+		const T u = 1 - uniform<T>(), v = uniform<T>();
+		return mean + stddev * std::sqrt(-2 * std::log(u)) * std::cos(2 * std::numbers::pi_v<T> * v);
+	}
+
+	void fill(std::span<uint64_t> values)
+	{
+		for (uint64_t &value : values)
+		{
+			value = (*this)();
+		}
+	}
+
+	template <std::floating_point T>
+	void fill(std::span<T> values, T min = 0, T max = 1)
+	{
+		for (T &value : values)
+		{
+			value = uniform<T>(min, max);
+		}
+	}
+
+	// Fills with normally distributed values, two at a time (Box-Muller)
+	template <std::floating_point T>
+	void fill_normal(std::span<T> values, T mean = 0, T stddev = 1)
+	{
+		for (size_t i = 0; i < values.size(); i += 2)
+		{
+			const T u = 1 - uniform<T>(), v = uniform<T>();
+			const T radius = stddev * std::sqrt(-2 * std::log(u)), angle = 2 * std::numbers::pi_v<T> * v;
+			values[i] = mean + radius * std::cos(angle);
+			if (i + 1 < values.size())
+			{
+				values[i + 1] = mean + radius * std::sin(angle);
+			}
+		}
+	}
+
+	// The generator of the calling thread
+	static Random &local()
+	{
+		thread_local uint64_t epoch = _epoch.load();
+		thread_local Random random(_seed.load(), _streams.fetch_add(1));
+		if (const uint64_t current = _epoch.load(std::memory_order_acquire); epoch != current)
+		{
+			epoch = current;
+			random = Random(_seed.load(), _streams.fetch_add(1));
+		}
+		return random;
+	}
+
+	// Seeds every thread's generator, so a run can be repeated
+	static void seed(uint64_t seed)
+	{
+		_seed = seed;
+		_streams = 0;
+		_epoch.fetch_add(1, std::memory_order_release);
+		local();
+	}
+
+	// The seed the generators of threads are created from
+	static uint64_t seed()
+	{
+		return _seed;
+	}
+
+	class Scope;
+};
+
+// Replaces the calling thread's generator with a stream of a seed until the end of the scope
+class Random::Scope
+{
+	Random previous;
+
+public:
+	Scope(uint64_t seed, uint64_t stream) : previous(local())
+	{
+		local() = Random(seed, stream);
+	}
+
+	Scope(const Scope &) = delete;
+	Scope &operator=(const Scope &) = delete;
+
+	~Scope()
+	{
+		local() = previous;
+	}
+};
+
+#endif
@@ -0,0 +1,586 @@
+#ifndef H_Server
+#define H_Server
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+#include <filesystem>
+#include <condition_variable>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "File.hpp"
+#include "MappedFile.hpp"
+#include "NeuralNetwork.hpp"
+
+/*
+The protocol of tempest-serve, over a Unix stream socket.
+A request is a RequestHeader followed by its inputs as floats. It is answered by a ResponseHeader followed by the outputs as floats,
+or by an error message when the status is not OK. Numbers are in host byte order, since both ends are on the same machine.
+Requests can be pipelined. Responses carry the ID of their request, and requests to the same network are answered in order.
+*/
+namespace serve
+{
+	struct RequestHeader
+	{
+		uint32_t id;	  // chosen by the client, and copied to the response
+		uint32_t network; // index of the network, in the order the server was given them
+		uint32_t count;	  // number of inputs
+	};
+
+	enum class Status : uint32_t
+	{
+		OK,
+		UNKNOWN_NETWORK,
+		INVALID_INPUTS,
+		ERROR,
+	};
+
+	struct ResponseHeader
+	{
+		uint32_t id;
+		Status status;
+		uint32_t count; // number of outputs, or length of the error message
+	};
+
+	// largest number of inputs of a request, so a bad header can not make the server allocate without bound
+	constexpr uint32_t maxCount = 1 << 24;
+
+	// Reads exactly size bytes, returning false if the connection was closed first
+	inline bool read_all(int fd, void *data, size_t size)
+	{
+		char *position = static_cast<char *>(data);
+		while (size > 0)
+		{
+			const ssize_t read = ::recv(fd, position, size, 0);
+			if (read < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (read <= 0)
+			{
+				return false;
+			}
+			position += read;
+			size -= read;
+		}
+		return true;
+	}
+
+	// Writes every byte of a header and its payload in as few calls as possible, returning false if the connection was closed
+	inline bool write_all(int fd, const void *header, size_t headerSize, const void *payload, size_t payloadSize)
+	{
+		iovec parts[2] = {{const_cast<void *>(header), headerSize}, {const_cast<void *>(payload), payloadSize}};
+		msghdr message{};
+		message.msg_iov = parts;
+		message.msg_iovlen = 2;
+		while (message.msg_iovlen > 0)
+		{
+			ssize_t written = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+			if (written < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (written < 0)
+			{
+				return false;
+			}
+			while (message.msg_iovlen > 0 && static_cast<size_t>(written) >= message.msg_iov->iov_len)
+			{
+				written -= message.msg_iov->iov_len;
+				message.msg_iov++;
+				message.msg_iovlen--;
+			}
+			if (message.msg_iovlen > 0)
+			{
+				message.msg_iov->iov_base = static_cast<char *>(message.msg_iov->iov_base) + written;
+				message.msg_iov->iov_len -= written;
+			}
+		}
+		return true;
+	}
+
+	inline sockaddr_un address(const std::string &path)
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path))
+		{
+			throw std::invalid_argument("Socket path is too long: " + path);
+		}
+		std::strcpy(address.sun_path, path.c_str());
+		return address;
+	}
+}
+
+/*
+Answers requests to run networks over a Unix socket (see the serve namespace for the protocol).
+Networks are read and compiled once. Each one has a thread that runs the requests queued for it,
+taking every queued request (up to maxBatch) as one batch, so concurrent requests share a traversal of the network.
+Networks are reloaded from their files on reload(), replacing the plan between batches, so queued and running requests are still answered.
+*/
+class Server
+{
+public:
+	using Values = Plan::Values;
+
+	unsigned maxDepth = 1000;
+	Propagation propagation = Propagation::RECURSIVE;
+	Quantization precision = Quantization::NONE;
+
+	// threads each network's batches are run on
+	unsigned threads = 1;
+
+	// most requests run as one batch
+	size_t maxBatch = 256;
+
+	// how long a batch waits for more requests after the first one, 0 to only take requests that are already queued
+	std::chrono::microseconds batchWait{0};
+
+	// Reads and compiles the networks, which are numbered in the order given
+	Server(const std::vector<std::string> &paths, unsigned max_depth = 1000, Propagation propagation = Propagation::RECURSIVE, Quantization precision = Quantization::NONE, unsigned threads = 1)
+		: maxDepth(max_depth), propagation(propagation), precision(precision), threads(threads)
+	{
+		for (const std::string &path : paths)
+		{
+			std::unique_ptr<Model> model = std::make_unique<Model>();
+			model->path = path;
+			model->modified = std::filesystem::last_write_time(path);
+			model->plan = _load(path);
+			models.push_back(std::move(model));
+		}
+	}
+
+	Server(const Server &) = delete;
+	Server &operator=(const Server &) = delete;
+
+	~Server()
+	{
+		stop();
+		for (std::unique_ptr<Model> &model : models)
+		{
+			if (model->batcher.joinable())
+			{
+				model->batcher.join();
+			}
+		}
+		if (listener >= 0)
+		{
+			::close(listener);
+			::unlink(socketPath.c_str());
+		}
+	}
+
+	size_t size() const
+	{
+		return models.size();
+	}
+
+	// The plan currently serving a network
+	std::shared_ptr<const Plan> plan(size_t network) const
+	{
+		std::lock_guard lock(models.at(network)->mutex);
+		return models.at(network)->plan;
+	}
+
+	const std::string &path(size_t network) const
+	{
+		return models.at(network)->path;
+	}
+
+	// Binds the socket, replacing a stale socket file left at the path
+	void listen(const std::string &path)
+	{
+		const sockaddr_un address = serve::address(path);
+		listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (listener < 0)
+		{
+			throw std::runtime_error("Failed to create socket: " + std::string(std::strerror(errno)));
+		}
+		::unlink(path.c_str());
+		if (::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 || ::listen(listener, SOMAXCONN) < 0)
+		{
+			const std::string error = std::strerror(errno);
+			::close(listener);
+			listener = -1;
+			throw std::runtime_error("Failed to listen on " + path + ": " + error);
+		}
+		socketPath = path;
+	}
+
+	// Accepts connections until stop() is called, then waits for their readers to finish
+	void serve()
+	{
+		for (std::unique_ptr<Model> &model : models)
+		{
+			model->batcher = std::thread(&Server::_batch, this, std::ref(*model));
+		}
+
+		while (!stopping)
+		{
+			const int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0)
+			{
+				if (errno == EINTR || errno == ECONNABORTED)
+				{
+					continue;
+				}
+				break;
+			}
+
+			// a client that stops reading its responses is dropped, rather than holding up its networks
+			const timeval timeout{1, 0};
+			::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+			std::shared_ptr<Connection> connection = std::make_shared<Connection>(fd);
+			std::lock_guard lock(connectionsMutex);
+			if (stopping)
+			{
+				break;
+			}
+			connections.push_back(connection);
+			readers++;
+			std::thread(&Server::_read, this, connection).detach();
+		}
+
+		stop();
+		std::unique_lock lock(connectionsMutex);
+		idle.wait(lock, [&]
+				  { return readers == 0; });
+	}
+
+	// Stops accepting connections and closes those that are open. Safe to call from any thread
+	void stop()
+	{
+		{
+			std::lock_guard lock(connectionsMutex);
+			if (stopping.exchange(true))
+			{
+				return;
+			}
+			for (const std::weak_ptr<Connection> &weak : connections)
+			{
+				if (std::shared_ptr<Connection> connection = weak.lock())
+				{
+					::shutdown(connection->fd, SHUT_RDWR);
+				}
+			}
+		}
+		if (listener >= 0)
+		{
+			::shutdown(listener, SHUT_RDWR);
+		}
+		for (std::unique_ptr<Model> &model : models)
+		{
+			std::lock_guard lock(model->mutex);
+			model->ready.notify_all();
+		}
+	}
+
+	/*
+		Reads and compiles a network's file again, then swaps it in between two batches.
+		If the file can not be read, the network keeps being served as it was and the error is thrown,
+		and the file is not modified() again until it changes.
+		Files should be replaced by renaming a new file over them, so a reload never reads one that is half written.
+	*/
+	void reload(size_t network)
+	{
+		Model &model = *models.at(network);
+		{
+			std::lock_guard lock(model.mutex);
+			model.modified = std::filesystem::last_write_time(model.path);
+		}
+		std::shared_ptr<Plan> plan = _load(model.path);
+		std::lock_guard lock(model.mutex);
+		model.plan = std::move(plan);
+	}
+
+	// Whether a network's file was modified since it was last loaded
+	bool modified(size_t network) const
+	{
+		const Model &model = *models.at(network);
+		std::error_code error;
+		const std::filesystem::file_time_type modified = std::filesystem::last_write_time(model.path, error);
+		std::lock_guard lock(model.mutex);
+		return !error && modified != model.modified;
+	}
+
+protected:
+	struct Connection
+	{
+		int fd;
+
+		// responses from different networks' threads are written whole
+		std::mutex writing;
+
+		explicit Connection(int fd) : fd(fd) {}
+
+		~Connection()
+		{
+			::close(fd);
+		}
+
+		void respond(uint32_t id, serve::Status status, const void *payload, uint32_t count, size_t itemSize)
+		{
+			const serve::ResponseHeader header{id, status, count};
+			std::lock_guard lock(writing);
+			// a client that went away or stopped reading only loses its own responses
+			if (!serve::write_all(fd, &header, sizeof(header), payload, count * itemSize))
+			{
+				::shutdown(fd, SHUT_RDWR);
+			}
+		}
+
+		void respond(uint32_t id, const Values &outputs)
+		{
+			respond(id, serve::Status::OK, outputs.data(), outputs.size(), sizeof(float));
+		}
+
+		void fail(uint32_t id, serve::Status status, const std::string &message)
+		{
+			respond(id, status, message.data(), message.size(), 1);
+		}
+	};
+
+	struct Request
+	{
+		std::shared_ptr<Connection> connection;
+		uint32_t id;
+		Values inputs;
+	};
+
+	struct Model
+	{
+		std::string path;
+		std::filesystem::file_time_type modified;
+
+		// guards plan, modified and queue
+		mutable std::mutex mutex;
+		std::condition_variable ready;
+		std::shared_ptr<Plan> plan;
+		std::deque<Request> queue;
+		std::thread batcher;
+	};
+
+	std::vector<std::unique_ptr<Model>> models;
+
+	int listener = -1;
+	std::string socketPath;
+	std::atomic<bool> stopping = false;
+
+	std::mutex connectionsMutex;
+	std::vector<std::weak_ptr<Connection>> connections;
+	size_t readers = 0;
+	std::condition_variable idle;
+
+	std::shared_ptr<Plan> _load(const std::string &path) const
+	{
+		File file;
+		// the file's network is not freed by the file
+		std::unique_ptr<NeuralNetwork> network(file.network);
+		file.readHeader(path);
+		if (file.type() != FileType::NETWORK && file.type() != FileType::PARTIAL)
+		{
+			throw std::runtime_error("Not a network: " + path);
+		}
+
+		// the plan is compiled without a source, so batches start from the stored values and the file is not needed afterwards
+		std::shared_ptr<Plan> plan;
+		if (file.mapped())
+		{
+			plan = std::make_shared<Plan>(MappedFile(path, sizeof(File::Header)));
+		}
+		else
+		{
+			file.readPath(path);
+			plan = std::make_shared<Plan>(std::as_const(*network));
+		}
+		plan->propagation = propagation;
+		plan->quantize(precision);
+		if (threads > 1)
+		{
+			plan->pool = std::make_shared<ThreadPool>(threads);
+		}
+		return plan;
+	}
+
+	// Reads the requests of a connection and queues them for their network's thread
+	void _read(std::shared_ptr<Connection> connection)
+	{
+		serve::RequestHeader header;
+		while (!stopping && serve::read_all(connection->fd, &header, sizeof(header)))
+		{
+			if (header.count > serve::maxCount)
+			{
+				connection->fail(header.id, serve::Status::INVALID_INPUTS, "Too many inputs");
+				break;
+			}
+			Values inputs(header.count);
+			if (!serve::read_all(connection->fd, inputs.data(), inputs.size() * sizeof(float)))
+			{
+				break;
+			}
+			if (header.network >= models.size())
+			{
+				connection->fail(header.id, serve::Status::UNKNOWN_NETWORK, "Unknown network " + std::to_string(header.network));
+				continue;
+			}
+
+			Model &model = *models[header.network];
+			std::lock_guard lock(model.mutex);
+			model.queue.push_back({connection, header.id, std::move(inputs)});
+			model.ready.notify_one();
+		}
+
+		std::lock_guard lock(connectionsMutex);
+		std::erase_if(connections, [&](const std::weak_ptr<Connection> &weak)
+					  { return weak.expired() || weak.lock() == connection; });
+		if (--readers == 0)
+		{
+			idle.notify_all();
+		}
+	}
+
+	// Runs the queued requests of a network, in batches of those that arrived together
+	void _batch(Model &model)
+	{
+		std::vector<Request> requests;
+		Plan::Batch rows;
+		while (true)
+		{
+			std::shared_ptr<Plan> plan;
+			{
+				std::unique_lock lock(model.mutex);
+				model.ready.wait(lock, [&]
+								 { return stopping || !model.queue.empty(); });
+				if (stopping)
+				{
+					return;
+				}
+				if (batchWait.count() > 0 && model.queue.size() < maxBatch)
+				{
+					model.ready.wait_for(lock, batchWait, [&]
+										 { return stopping || model.queue.size() >= maxBatch; });
+				}
+
+				const size_t count = std::min(maxBatch, model.queue.size());
+				requests.clear();
+				std::move(model.queue.begin(), model.queue.begin() + count, std::back_inserter(requests));
+				model.queue.erase(model.queue.begin(), model.queue.begin() + count);
+				plan = model.plan;
+			}
+
+			// requests that do not fit the plan are answered on their own, since a reload may have changed its inputs
+			rows.clear();
+			std::erase_if(requests, [&](Request &request)
+						  {
+				if (request.inputs.size() == plan->inputs.size())
+				{
+					return false;
+				}
+				request.connection->fail(request.id, serve::Status::INVALID_INPUTS, "Expected " + std::to_string(plan->inputs.size()) + " inputs");
+				return true; });
+			for (Request &request : requests)
+			{
+				rows.push_back(std::move(request.inputs));
+			}
+			if (rows.empty())
+			{
+				continue;
+			}
+
+			try
+			{
+				const Plan::Batch outputs = plan->runBatch(rows, maxDepth, rows.size());
+				for (size_t i = 0; i < requests.size(); i++)
+				{
+					requests[i].connection->respond(requests[i].id, outputs[i]);
+				}
+			}
+			catch (const std::exception &error)
+			{
+				for (const Request &request : requests)
+				{
+					request.connection->fail(request.id, serve::Status::ERROR, error.what());
+				}
+			}
+		}
+	}
+};
+
+/*
+A client of tempest-serve, making one request at a time.
+Programs that pipeline requests can use the protocol directly.
+*/
+class Client
+{
+public:
+	using Values = Plan::Values;
+
+	explicit Client(const std::string &path)
+	{
+		const sockaddr_un address = serve::address(path);
+		fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0)
+		{
+			const std::string error = std::strerror(errno);
+			if (fd >= 0)
+			{
+				::close(fd);
+			}
+			throw std::runtime_error("Failed to connect to " + path + ": " + error);
+		}
+	}
+
+	Client(const Client &) = delete;
+	Client &operator=(const Client &) = delete;
+
+	~Client()
+	{
+		::close(fd);
+	}
+
+	// Runs inputs against one of the server's networks
+	Values run(uint32_t network, const Values &inputs)
+	{
+		const serve::RequestHeader request{nextId++, network, static_cast<uint32_t>(inputs.size())};
+		if (!serve::write_all(fd, &request, sizeof(request), inputs.data(), inputs.size() * sizeof(float)))
+		{
+			throw std::runtime_error("Connection to server lost");
+		}
+
+		serve::ResponseHeader response;
+		if (!serve::read_all(fd, &response, sizeof(response)) || response.count > serve::maxCount)
+		{
+			throw std::runtime_error("Connection to server lost");
+		}
+		if (response.status != serve::Status::OK)
+		{
+			std::string message(response.count, '\0');
+			serve::read_all(fd, message.data(), message.size());
+			throw std::runtime_error(message);
+		}
+		Values outputs(response.count);
+		if (!serve::read_all(fd, outputs.data(), outputs.size() * sizeof(float)))
+		{
+			throw std::runtime_error("Connection to server lost");
+		}
+		return outputs;
+	}
+
+protected:
+	int fd = -1;
+	uint32_t nextId = 0;
+};
+
+#endif
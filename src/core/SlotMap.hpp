@@ -0,0 +1,421 @@
+#ifndef H_SlotMap
+#define H_SlotMap
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <type_traits>
+#include <optional>
+#include <utility>
+#include <iterator>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+Contiguous container addressed by generational keys.
+The low 32 bits of a key are the index of its slot and the high 32 bits are the slot's generation,
+which is incremented when the slot is freed so stale keys are detected.
+Elements are iterated in slot order.
+*/
+template <typename T>
+class SlotMap
+{
+public:
+	using Key = size_t;
+	using value_type = std::pair<const Key, T>;
+
+	static constexpr Key index(Key key)
+	{
+		return key & UINT32_MAX;
+	}
+
+	static constexpr uint32_t generation(Key key)
+	{
+		return key >> 32;
+	}
+
+	static constexpr Key key(size_t index, uint32_t generation)
+	{
+		return (static_cast<Key>(generation) << 32) | index;
+	}
+
+protected:
+	using Slot = std::optional<value_type>;
+
+	static constexpr size_t pageSize = 64;
+
+	// slots are stored in pages, which copies of the map share until either of them changes the page
+	struct Page
+	{
+		const SlotMap *owner = nullptr; // the map whose _adopt was last applied to the page's elements
+		std::array<Slot, pageSize> slots;
+		std::array<uint32_t, pageSize> generations{};
+	};
+
+	std::vector<std::shared_ptr<Page>> _pages;
+
+	// number of slots, including free ones
+	size_t _count = 0;
+
+	// free slots, which may include slots since filled by key (these are skipped)
+	std::vector<uint32_t> _free;
+
+	size_t _size = 0;
+
+	// pages whose elements are adopted again when the map next changes them, even if it already owns them
+	std::vector<bool> _stale;
+
+	// called on elements that move into a page only this map uses, e.g. to fix pointers back to the map
+	virtual void _adopt([[maybe_unused]] T &value)
+	{
+	}
+
+	const Slot &_slot(size_t index) const
+	{
+		return _pages[index / pageSize]->slots[index % pageSize];
+	}
+
+	uint32_t _generation(size_t index) const
+	{
+		return _pages[index / pageSize]->generations[index % pageSize];
+	}
+
+	// the page at an index, copied first if other maps still use it
+	Page &_own(size_t page)
+	{
+		std::shared_ptr<Page> &shared = _pages[page];
+		if (shared.use_count() > 1)
+		{
+			shared = std::make_shared<Page>(*shared);
+		}
+		else
+		{
+			// pairs with the release of the last other reference, so its reads of the page happen before our writes
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+
+		if (shared->owner != this || _stale[page])
+		{
+			shared->owner = this;
+			for (Slot &slot : shared->slots)
+			{
+				if (slot)
+				{
+					_adopt(slot->second);
+				}
+			}
+			_stale[page] = false;
+		}
+		return *shared;
+	}
+
+	// Marks the page of a slot, so its elements are adopted again before the map next changes them
+	void _mark_stale(size_t index)
+	{
+		_stale[index / pageSize] = true;
+	}
+
+	bool _is_stale(size_t index) const
+	{
+		return _stale[index / pageSize];
+	}
+
+	Slot &_mutable_slot(size_t index)
+	{
+		return _own(index / pageSize).slots[index % pageSize];
+	}
+
+	// drop filled slots from the back of the free list
+	void _prune()
+	{
+		while (!_free.empty() && _slot(_free.back()))
+		{
+			_free.pop_back();
+		}
+	}
+
+	template <typename Map, typename Value>
+	class basic_iterator
+	{
+		Map *map = nullptr;
+		size_t i = 0;
+
+		void skip()
+		{
+			while (i < map->_count && !map->_slot(i))
+			{
+				i++;
+			}
+		}
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = SlotMap::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Value *;
+		using reference = Value &;
+
+		basic_iterator() = default;
+
+		basic_iterator(Map *map, size_t index) : map(map), i(index)
+		{
+			skip();
+		}
+
+		// mutable elements are reached through _mutable_slot, so their page is unshared first
+		reference operator*() const
+		{
+			if constexpr (std::is_const_v<Map>)
+			{
+				return *map->_slot(i);
+			}
+			else
+			{
+				return *map->_mutable_slot(i);
+			}
+		}
+
+		pointer operator->() const
+		{
+			return &**this;
+		}
+
+		basic_iterator &operator++()
+		{
+			i++;
+			skip();
+			return *this;
+		}
+
+		basic_iterator operator++(int)
+		{
+			basic_iterator copy = *this;
+			++*this;
+			return copy;
+		}
+
+		bool operator==(const basic_iterator &other) const
+		{
+			return i == other.i;
+		}
+	};
+
+public:
+	using iterator = basic_iterator<SlotMap, value_type>;
+	using const_iterator = basic_iterator<const SlotMap, const value_type>;
+
+	SlotMap() = default;
+
+	/*
+		Copies share all of their pages with the original, so copying costs one pointer per page.
+		A page is copied when either map first changes it, so references to elements may be invalidated by non-const access.
+	*/
+	SlotMap(const SlotMap &other) = default;
+	SlotMap &operator=(const SlotMap &other) = default;
+
+	virtual ~SlotMap() = default;
+
+	iterator begin()
+	{
+		return {this, 0};
+	}
+
+	iterator end()
+	{
+		return {this, _count};
+	}
+
+	const_iterator begin() const
+	{
+		return {this, 0};
+	}
+
+	const_iterator end() const
+	{
+		return {this, _count};
+	}
+
+	size_t size() const
+	{
+		return _size;
+	}
+
+	bool empty() const
+	{
+		return _size == 0;
+	}
+
+	// number of slots, including free ones
+	size_t slots() const
+	{
+		return _count;
+	}
+
+	// whether the page of a slot is used by this map alone, so changing the slot does not copy anything
+	bool owns(size_t index) const
+	{
+		const std::shared_ptr<Page> &page = _pages[index / pageSize];
+		return page.use_count() == 1 && page->owner == this;
+	}
+
+	bool used(size_t index) const
+	{
+		return index < _count && _slot(index).has_value();
+	}
+
+	// whether a key refers to an element that has since been erased from its slot
+	bool expired(Key key) const
+	{
+		return index(key) < _count && generation(key) < _generation(index(key));
+	}
+
+	bool contains(Key key) const
+	{
+		return used(index(key)) && _slot(index(key))->first == key;
+	}
+
+	T &at(Key key)
+	{
+		if (!contains(key))
+		{
+			throw std::out_of_range("Invalid key");
+		}
+		return _mutable_slot(index(key))->second;
+	}
+
+	const T &at(Key key) const
+	{
+		if (!contains(key))
+		{
+			throw std::out_of_range("Invalid key");
+		}
+		return _slot(index(key))->second;
+	}
+
+	T &at_slot(size_t index)
+	{
+		if (!used(index))
+		{
+			throw std::out_of_range("Empty slot");
+		}
+		return _mutable_slot(index)->second;
+	}
+
+	const T &at_slot(size_t index) const
+	{
+		if (!used(index))
+		{
+			throw std::out_of_range("Empty slot");
+		}
+		return _slot(index)->second;
+	}
+
+	iterator find(Key key)
+	{
+		return contains(key) ? iterator(this, index(key)) : end();
+	}
+
+	const_iterator find(Key key) const
+	{
+		return contains(key) ? const_iterator(this, index(key)) : end();
+	}
+
+	// whether an element can be inserted with a key
+	bool available(Key key) const
+	{
+		const size_t i = index(key);
+		if (i >= _count)
+		{
+			return i < UINT32_MAX;
+		}
+		return !_slot(i) && generation(key) >= _generation(i);
+	}
+
+	// the key the next emplaced element will have
+	Key next_key() const
+	{
+		if (!_free.empty())
+		{
+			return key(_free.back(), _generation(_free.back()));
+		}
+		return key(_count, 0);
+	}
+
+	template <typename... Args>
+	Key emplace(Args &&...args)
+	{
+		const Key k = next_key();
+		emplace_at(k, std::forward<Args>(args)...);
+		return k;
+	}
+
+	// insert an element with a specific key, returning false if the key is not available
+	template <typename... Args>
+	bool emplace_at(Key k, Args &&...args)
+	{
+		if (!available(k))
+		{
+			return false;
+		}
+
+		const size_t i = index(k);
+		if (i >= _count)
+		{
+			for (size_t free = i; free > _count; free--)
+			{
+				_free.push_back(free - 1);
+			}
+			_count = i + 1;
+			while (_pages.size() * pageSize < _count)
+			{
+				_pages.push_back(std::make_shared<Page>());
+				_pages.back()->owner = this;
+				_stale.push_back(false);
+			}
+		}
+
+		Page &page = _own(i / pageSize);
+		page.generations[i % pageSize] = generation(k);
+		page.slots[i % pageSize].emplace(std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<Args>(args)...));
+		_size++;
+		_prune();
+		return true;
+	}
+
+	bool insert(Key k, const T &value)
+	{
+		return emplace_at(k, value);
+	}
+
+	void erase(Key k)
+	{
+		if (!contains(k))
+		{
+			throw std::out_of_range("Invalid key");
+		}
+
+		const size_t i = index(k);
+		Page &page = _own(i / pageSize);
+		page.slots[i % pageSize].reset();
+		page.generations[i % pageSize]++;
+		_free.push_back(i);
+		_size--;
+	}
+
+	void clear()
+	{
+		_pages.clear();
+		_stale.clear();
+		_count = 0;
+		_free.clear();
+		_size = 0;
+	}
+
+	void reserve(size_t capacity)
+	{
+		_pages.reserve((capacity + pageSize - 1) / pageSize);
+	}
+};
+
+#endif
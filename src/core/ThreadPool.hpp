@@ -0,0 +1,210 @@
+#ifndef H_ThreadPool
+#define H_ThreadPool
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+#include <cstdint>
+
+/*
+Persistent worker threads for parallel loops.
+Each loop's range is split evenly between the workers. A worker that runs out of work steals the back half of another worker's range.
+The calling thread takes part as worker 0.
+*/
+class ThreadPool
+{
+public:
+	using Task = std::function<void(size_t index, unsigned worker)>;
+
+protected:
+	// range of indices as (begin << 32) | end, so it can be split with one compare-exchange
+	struct alignas(64) Range
+	{
+		std::atomic<uint64_t> bounds{0};
+	};
+
+	static constexpr uint64_t pack(uint64_t begin, uint64_t end)
+	{
+		return (begin << 32) | end;
+	}
+
+	std::vector<std::thread> workers;
+	std::vector<Range> ranges;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const Task *task = nullptr;
+	size_t generation = 0;
+	unsigned active = 0;
+	bool stopping = false;
+	std::exception_ptr error;
+
+	// take the next index of a worker's own range
+	bool _pop(unsigned worker, size_t &index)
+	{
+		std::atomic<uint64_t> &bounds = ranges[worker].bounds;
+		uint64_t current = bounds.load();
+		while (true)
+		{
+			const uint64_t begin = current >> 32, end = current & UINT32_MAX;
+			if (begin >= end)
+			{
+				return false;
+			}
+			if (bounds.compare_exchange_weak(current, pack(begin + 1, end)))
+			{
+				index = begin;
+				return true;
+			}
+		}
+	}
+
+	// move the back half of another worker's range to this worker
+	bool _steal(unsigned worker)
+	{
+		for (unsigned offset = 1; offset < ranges.size(); offset++)
+		{
+			std::atomic<uint64_t> &victim = ranges[(worker + offset) % ranges.size()].bounds;
+			uint64_t current = victim.load();
+			while (true)
+			{
+				const uint64_t begin = current >> 32, end = current & UINT32_MAX;
+				if (begin >= end)
+				{
+					break;
+				}
+				const uint64_t middle = begin + (end - begin) / 2;
+				if (victim.compare_exchange_weak(current, pack(begin, middle)))
+				{
+					ranges[worker].bounds.store(pack(middle, end));
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void _work(unsigned worker)
+	{
+		try
+		{
+			size_t index;
+			do
+			{
+				while (_pop(worker, index))
+				{
+					(*task)(index, worker);
+				}
+			} while (_steal(worker));
+		}
+		catch (...)
+		{
+			std::lock_guard lock(mutex);
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	}
+
+	void _run(unsigned worker)
+	{
+		size_t seen = 0;
+		while (true)
+		{
+			{
+				std::unique_lock lock(mutex);
+				wake.wait(lock, [&]
+						  { return stopping || generation != seen; });
+				if (stopping)
+				{
+					return;
+				}
+				seen = generation;
+			}
+
+			_work(worker);
+
+			std::lock_guard lock(mutex);
+			if (--active == 0)
+			{
+				done.notify_one();
+			}
+		}
+	}
+
+public:
+	ThreadPool(unsigned threads = std::thread::hardware_concurrency()) : ranges(threads > 0 ? threads : 1)
+	{
+		for (unsigned worker = 1; worker < ranges.size(); worker++)
+		{
+			workers.emplace_back(&ThreadPool::_run, this, worker);
+		}
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread &thread : workers)
+		{
+			thread.join();
+		}
+	}
+
+	unsigned size() const
+	{
+		return ranges.size();
+	}
+
+	/*
+		Calls task for every index in [0, count), and returns once all of them are done.
+		The first exception thrown by a task is rethrown here.
+	*/
+	void parallel_for(size_t count, const Task &_task)
+	{
+		if (count > UINT32_MAX)
+		{
+			throw std::length_error("Too many indices for a parallel loop");
+		}
+
+		for (unsigned worker = 0; worker < size(); worker++)
+		{
+			ranges[worker].bounds.store(pack(count * worker / size(), count * (worker + 1) / size()));
+		}
+
+		{
+			std::lock_guard lock(mutex);
+			task = &_task;
+			error = nullptr;
+			active = size() - 1;
+			generation++;
+		}
+		wake.notify_all();
+
+		_work(0);
+
+		std::unique_lock lock(mutex);
+		done.wait(lock, [&]
+				  { return active == 0; });
+		task = nullptr;
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+#endif
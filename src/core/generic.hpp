@@ -95,7 +95,7 @@ class BaseElement : public Reflectable
 public:
 	struct MutationOptions
 	{
-		float clumping;
+		float clumping = 1;
 	};
 
 	virtual void mutate([[maybe_unused]] const MutationOptions &options)
@@ -70,14 +70,7 @@ element_t nextTo(const std::vector<element_t> &vector, const element_t &element,
 	return *std::next(std::find(vector.begin(), vector.end(), element), offset);
 };
 
-template <typename random_t>
-random_t rand_seeded()
-{
-	[[maybe_unused]] static bool const _rand_seeded_is_seeded = (std::srand(static_cast<unsigned>(std::time(0))), true);
-	return static_cast<random_t>(std::rand());
-}
-
-std::vector<std::string> split(const std::string &input, const std::string &delimiter, size_t start = 0)
+inline std::vector<std::string> split(const std::string &input, const std::string &delimiter, size_t start = 0)
 {
 	std::vector<std::string> tokens;
 	size_t end = input.find(delimiter);
@@ -102,8 +95,8 @@ T stonum(std::string &str)
 	return value;
 }
 
-bool debug = 0;
-std::ostream &debug_output_default = std::cout;
+inline bool debug = 0;
+inline std::ostream &debug_output_default = std::cout;
 
 template <typename... TData>
 void log_debug(std::ostream &out, TData &&...data)
@@ -124,7 +117,7 @@ void log_debug(TData &&...data)
 	log_debug(debug_output_default, data...);
 }
 
-void log_debug(const std::string &message, std::ostream &out = debug_output_default)
+inline void log_debug(const std::string &message, std::ostream &out = debug_output_default)
 {
 	if (!debug)
 	{
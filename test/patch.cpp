@@ -0,0 +1,167 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include "core/NeuralNetwork.hpp"
+
+/*
+	Checks that a plan patched after each change to its network runs the same as a plan compiled from scratch.
+	Networks are changed the ways patching has to follow: mutations, removals (which leave dangling connections),
+	added neurons, connections, and connections to neurons that are only added later.
+*/
+
+namespace
+{
+	// NaN is produced by some activations, and counts as equal to itself
+	bool same(const NeuralNetwork::Values &a, const NeuralNetwork::Values &b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i] != b[i] && !(std::isnan(a[i]) && std::isnan(b[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Runs a plan, returning the error message, if any, instead of outputs
+	std::string run(Plan &plan, const NeuralNetwork::Values &inputs, NeuralNetwork::Values &outputs, std::vector<NeuralNetwork::Values> &batch)
+	{
+		try
+		{
+			outputs = plan.run(inputs, 20);
+			batch = plan.runBatch({inputs, inputs}, 20);
+		}
+		catch (const std::exception &e)
+		{
+			return e.what();
+		}
+		return "";
+	}
+
+	// Changes the network in one of the ways patching follows
+	void change(NeuralNetwork &network, Random &random)
+	{
+		switch (random.below(6))
+		{
+		case 0:
+		case 1:
+			try
+			{
+				network.mutate();
+			}
+			catch (const std::exception &)
+			{
+			}
+			break;
+		case 2:
+		{
+			const size_t slot = random.below(network.slots());
+			if (network.used(slot) && std::as_const(network).at_slot(slot).type == NeuronType::TRANSITIONAL)
+			{
+				network.remove(network.at_slot(slot).id());
+			}
+			break;
+		}
+		case 3:
+			network.create(random.chance(.1) ? NeuronType::INPUT : NeuronType::TRANSITIONAL);
+			break;
+		case 4:
+		{
+			const size_t source = random.below(network.slots()), target = random.below(network.slots());
+			if (network.used(source) && network.used(target))
+			{
+				network.at_slot(source).connect(network.at_slot(target));
+			}
+			break;
+		}
+		case 5:
+		{
+			// a connection to the next slot, whose neuron does not exist yet
+			const size_t source = random.below(network.slots());
+			if (network.used(source))
+			{
+				network.at_slot(source).outputs.push_back({SlotMap<Neuron>::key(network.slots(), 0), 1.5f, 0, 1, 0.9f});
+				network.invalidate(network.at_slot(source).id());
+			}
+			break;
+		}
+		}
+	}
+}
+
+int main()
+{
+	Random::seed(3);
+	size_t runs = 0, failures = 0;
+	for (int trial = 0; trial < 200; trial++)
+	{
+		NeuralNetwork network;
+		for (int i = 0; i < 40; i++)
+		{
+			network.create(i < 3 ? NeuronType::INPUT : i >= 37 ? NeuronType::OUTPUT : NeuronType::TRANSITIONAL);
+		}
+		for (auto &[id, neuron] : network)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				try
+				{
+					neuron.mutate({1});
+				}
+				catch (const std::exception &)
+				{
+				}
+			}
+		}
+		network.plan();
+
+		Random &random = Random::local();
+		for (int step = 0; step < 30; step++)
+		{
+			change(network, random);
+			if (!random.chance(.3))
+			{
+				continue;
+			}
+
+			NeuralNetwork copy(network);
+			Plan &patched = network.plan();
+			Plan compiled(copy);
+			const NeuralNetwork::Values inputs(compiled.inputs.size(), .7f);
+			for (Propagation propagation : {Propagation::RECURSIVE, Propagation::FRONTIER})
+			{
+				patched.propagation = compiled.propagation = propagation;
+				NeuralNetwork::Values a, b;
+				std::vector<NeuralNetwork::Values> batchA, batchB;
+				const std::string errorA = run(patched, inputs, a, batchA), errorB = run(compiled, inputs, b, batchB);
+				runs++;
+
+				bool equal = errorA == errorB && same(a, b) && batchA.size() == batchB.size();
+				for (size_t i = 0; equal && i < batchA.size(); i++)
+				{
+					equal = same(batchA[i], batchB[i]);
+				}
+				if (!equal)
+				{
+					failures++;
+					std::printf("trial %d step %d: patched plan differs from compiled (%s|%s)\n", trial, step, errorA.c_str(), errorB.c_str());
+				}
+			}
+			if (patched.inputs.size() != compiled.inputs.size() || patched.outputs.size() != compiled.outputs.size())
+			{
+				failures++;
+				std::printf("trial %d step %d: patched inputs or outputs differ from compiled\n", trial, step);
+			}
+		}
+	}
+	std::printf("%zu runs, %zu failures\n", runs, failures);
+	return failures == 0 ? 0 : 1;
+}